@@ -1,120 +1,77 @@
 #include "AnimationHelper.h"
+#include <algorithm>
 
-AnimationHelper::AnimationHelper(mat4& globalInverse, map<string, mat4>& offsetMapping)
-{
-	m_globalInverseMatrix = globalInverse;
-	m_BoneOffsetMatrixMapping = offsetMapping;
-}
-
-map<string, mat4> AnimationHelper::getBoneFinalTransformsAtFrame(uint frameIndex, aiAnimation* pAnimation, aiNode* pRootNode)
-{
-	calcFinalTransformsAtFrame(frameIndex, pAnimation, pRootNode);
-
-	return m_BoneFinalMatrixMapping;
-}
+namespace {
 
-void AnimationHelper::calcFinalTransformsAtFrame(uint frameIndex, aiAnimation* pAnimation, aiNode* pNode, mat4 &parentTransform /*= mat4()*/)
+// The first key of the pair to interpolate between: the first i with time < keys[i + 1].mTime, the last pair
+// if time is past the last key. With a cursor, the search starts from the key found last time if time has
+// not gone back before it; an unset cursor, or one past the keys, takes the binary search.
+template <typename Key>
+uint findKey(const Key* keys, uint numKeys, float time, uint* cursor)
 {
-	mat4 nodeTransform = pNode->mTransformation;
-
-	aiNodeAnim* pNodeAnim = findNodeAnim(pAnimation, pNode->mName);
-
-	if (pNodeAnim)
+	uint lastPair = numKeys - 2;
+	uint index;
+	if (cursor && *cursor <= lastPair && !(time < keys[*cursor].mTime))
 	{
-		aiVectorKey pos = frameIndex < pNodeAnim->mNumPositionKeys ? pNodeAnim->mPositionKeys[frameIndex]
-			: pNodeAnim->mPositionKeys[pNodeAnim->mNumPositionKeys - 1];
-
-		aiQuatKey rot = frameIndex < pNodeAnim->mNumRotationKeys ? pNodeAnim->mRotationKeys[frameIndex]
-			: pNodeAnim->mRotationKeys[pNodeAnim->mNumRotationKeys - 1];
-
-		aiVectorKey scaling = frameIndex < pNodeAnim->mNumScalingKeys ? pNodeAnim->mScalingKeys[frameIndex]
-			: pNodeAnim->mScalingKeys[pNodeAnim->mNumScalingKeys - 1];
-
-		nodeTransform = mat4(scaling.mValue, rot.mValue, pos.mValue);
+		index = *cursor;
+		while (index < lastPair && !(time < keys[index + 1].mTime))
+		{
+			++index;
+		}
 	}
-
-	mat4 globalTransform = parentTransform * nodeTransform;
-	std::string nodeName(pNode->mName.C_Str());
-	if (m_BoneOffsetMatrixMapping.find(nodeName) != m_BoneOffsetMatrixMapping.end())
+	else
 	{
-		m_BoneFinalMatrixMapping[nodeName] = m_globalInverseMatrix * globalTransform * m_BoneOffsetMatrixMapping[nodeName];
+		const Key* next = std::upper_bound(keys + 1, keys + numKeys, time, [](float t, const Key& key) { return t < key.mTime; });
+		index = std::min((uint)(next - keys) - 1, lastPair);
 	}
 
-// 	bool printout = false;
-// 	if (printout)
-// 	{
-// 		vec3 scaling, pos;
-// 		quat rot;
-// 		globalTransform.Decompose(scaling, rot, pos);
-// 		cout << "-------------------------" << endl;
-// 		cout << nodeName << endl;
-// 		cout << "Translation: " << pos.x << ", " << pos.y << ", " << pos.z << endl;
-// 		cout << "Scaling: " << scaling.x << ", " << scaling.y << ", " << scaling.z << endl;
-// 		cout << "Rotation: " << rot.x << ", " << rot.y << ", " << rot.z << ", " << rot.w << endl;
-// 		cout << "-------------------------" << endl;
-// 	}
-
-	for (uint i = 0; i < pNode->mNumChildren; ++i)
+	if (cursor) *cursor = index;
+	return index;
+}
+
+}
+
+aiNodeAnim* AnimationHelper::findNodeAnim(aiAnimation* pAnimation, const aiString& nodeName)
+{
+	if (pAnimation != m_indexedAnimation)
 	{
-		calcFinalTransformsAtFrame(frameIndex, pAnimation, pNode->mChildren[i], globalTransform);
+		indexChannels(pAnimation);
 	}
+
+	auto it = m_channelIndex.find(string(nodeName.C_Str(), nodeName.length));
+	return it != m_channelIndex.end() ? it->second : NULL;
 }
 
-aiNodeAnim* AnimationHelper::findNodeAnim(aiAnimation* pAnimation, aiString nodeName)
+void AnimationHelper::indexChannels(aiAnimation* pAnimation)
 {
+	m_channelIndex.clear();
+	m_channelIndex.reserve(pAnimation->mNumChannels);
 	for (uint i = 0; i < pAnimation->mNumChannels; ++i)
 	{
 		aiNodeAnim* pNodeAnim = pAnimation->mChannels[i];
 
-		if (pNodeAnim->mNodeName == nodeName)
-		{
-			return pNodeAnim;
-		}
+		// the first channel of a node wins, as it did with the linear search
+		m_channelIndex.insert(make_pair(string(pNodeAnim->mNodeName.C_Str(), pNodeAnim->mNodeName.length), pNodeAnim));
 	}
-
-	return NULL;
+	m_indexedAnimation = pAnimation;
 }
 
-uint AnimationHelper::findScaling(float AnimationTime, const aiNodeAnim* pNodeAnim)
+uint AnimationHelper::findScaling(float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor)
 {
-	for (uint i = 0; i < pNodeAnim->mNumScalingKeys - 1; ++i) 
-	{
-		if (AnimationTime < pNodeAnim->mScalingKeys[i + 1].mTime) 
-		{
-			return i;
-		}
-	}
-
-	return 0;
+	return findKey(pNodeAnim->mScalingKeys, pNodeAnim->mNumScalingKeys, AnimationTime, cursor ? &cursor->scaling : NULL);
 }
 
-uint AnimationHelper::findRotation(float AnimationTime, const aiNodeAnim* pNodeAnim)
+uint AnimationHelper::findRotation(float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor)
 {
-	for (uint i = 0; i < pNodeAnim->mNumRotationKeys - 1; ++i)
-	{
-		if (AnimationTime < pNodeAnim->mRotationKeys[i + 1].mTime)
-		{
-			return i;
-		}
-	}
-
-	return 0;
+	return findKey(pNodeAnim->mRotationKeys, pNodeAnim->mNumRotationKeys, AnimationTime, cursor ? &cursor->rotation : NULL);
 }
 
-uint AnimationHelper::findPosition(float AnimationTime, const aiNodeAnim* pNodeAnim)
+uint AnimationHelper::findPosition(float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor)
 {
-	for (uint i = 0; i < pNodeAnim->mNumPositionKeys - 1; ++i)
-	{
-		if (AnimationTime < pNodeAnim->mPositionKeys[i + 1].mTime)
-		{
-			return i;
-		}
-	}
-
-	return 0;
+	return findKey(pNodeAnim->mPositionKeys, pNodeAnim->mNumPositionKeys, AnimationTime, cursor ? &cursor->position : NULL);
 }
 
-void AnimationHelper::calcInterpolatedScaling(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+void AnimationHelper::calcInterpolatedScaling(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor)
 {
 	if (pNodeAnim->mNumScalingKeys == 1) 
 	{
@@ -122,7 +79,7 @@ void AnimationHelper::calcInterpolatedScaling(vec3& Out, float AnimationTime, co
 		return;
 	}
 
-	uint ScalingIndex = findScaling(AnimationTime, pNodeAnim);
+	uint ScalingIndex = findScaling(AnimationTime, pNodeAnim, cursor);
 	uint NextScalingIndex = (ScalingIndex + 1);
 	//assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
 	float DeltaTime = (float)(pNodeAnim->mScalingKeys[NextScalingIndex].mTime - pNodeAnim->mScalingKeys[ScalingIndex].mTime);
@@ -134,7 +91,7 @@ void AnimationHelper::calcInterpolatedScaling(vec3& Out, float AnimationTime, co
 	Out = Start + Factor * Delta;
 }
 
-void AnimationHelper::calcInterpolatedRotation(quat& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+void AnimationHelper::calcInterpolatedRotation(quat& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor)
 {
 	// we need at least two values to interpolate...
 	if (pNodeAnim->mNumRotationKeys == 1) 
@@ -143,7 +100,7 @@ void AnimationHelper::calcInterpolatedRotation(quat& Out, float AnimationTime, c
 		return;
 	}
 
-	uint RotationIndex = findRotation(AnimationTime, pNodeAnim);
+	uint RotationIndex = findRotation(AnimationTime, pNodeAnim, cursor);
 	uint NextRotationIndex = (RotationIndex + 1);
 	//assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
 	float DeltaTime = (float)(pNodeAnim->mRotationKeys[NextRotationIndex].mTime - pNodeAnim->mRotationKeys[RotationIndex].mTime);
@@ -155,7 +112,7 @@ void AnimationHelper::calcInterpolatedRotation(quat& Out, float AnimationTime, c
 	Out = Out.Normalize();
 }
 
-void AnimationHelper::calcInterpolatedPosition(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+void AnimationHelper::calcInterpolatedPosition(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor)
 {
 	if (pNodeAnim->mNumPositionKeys == 1) 
 	{
@@ -163,7 +120,7 @@ void AnimationHelper::calcInterpolatedPosition(vec3& Out, float AnimationTime, c
 		return;
 	}
 
-	uint PositionIndex = findPosition(AnimationTime, pNodeAnim);
+	uint PositionIndex = findPosition(AnimationTime, pNodeAnim, cursor);
 	uint NextPositionIndex = (PositionIndex + 1);
 	//assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
 	float DeltaTime = (float)(pNodeAnim->mPositionKeys[NextPositionIndex].mTime - pNodeAnim->mPositionKeys[PositionIndex].mTime);
@@ -1,17 +1,33 @@
 #pragma once
 #include "Common.h"
 #include <assimp/scene.h>
+#include <unordered_map>
 using namespace std;
 class AnimationHelper
 {
 public:
-	AnimationHelper() {}
-	AnimationHelper(mat4& globalInverse, map<string, mat4>& offsetMapping);
-	map<string, mat4> getBoneFinalTransformsAtFrame(uint frameIndex, aiAnimation* pAnimation, aiNode* pRootNode);
-	void calcInterpolatedScaling(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-	void calcInterpolatedRotation(quat& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-	void calcInterpolatedPosition(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-	aiNodeAnim* findNodeAnim(aiAnimation* pAnimation, aiString nodeName);
+	// the keys a channel was last sampled at, so that sampling it at increasing times finds the next keys
+	// without searching (other times fall back to a binary search). One per channel and per thread.
+	// A new cursor is unset, so its first lookup is a binary search rather than a walk from the first key.
+	struct KeyCursor
+	{
+		static const uint Unset = ~0u;
+
+		uint position;
+		uint rotation;
+		uint scaling;
+
+		KeyCursor() : position(Unset), rotation(Unset), scaling(Unset) {}
+	};
+
+	AnimationHelper() : m_indexedAnimation(NULL) {}
+	void calcInterpolatedScaling(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor = NULL);
+	void calcInterpolatedRotation(quat& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor = NULL);
+	void calcInterpolatedPosition(vec3& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor = NULL);
+	// the channel animating the node, NULL if there is none. The channels are looked up in an index built
+	// the first time an animation is searched: call indexChannels beforehand when searching from several threads.
+	aiNodeAnim* findNodeAnim(aiAnimation* pAnimation, const aiString& nodeName);
+	void indexChannels(aiAnimation* pAnimation);
 
 	void reSampleAnimation(aiAnimation* pAnimation);
 
@@ -19,15 +35,12 @@ public:
 	double& getFrameIntervalInTicks() { return m_frameIntervalInTicks; }
 
 private:
-	void calcFinalTransformsAtFrame(uint frameIndex, aiAnimation* pAnimation, aiNode* pNode, mat4 &parentTransform = mat4());
-
-	uint findScaling(float AnimationTime, const aiNodeAnim* pNodeAnim);
-	uint findRotation(float AnimationTime, const aiNodeAnim* pNodeAnim);
-	uint findPosition(float AnimationTime, const aiNodeAnim* pNodeAnim);
+	uint findScaling(float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor);
+	uint findRotation(float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor);
+	uint findPosition(float AnimationTime, const aiNodeAnim* pNodeAnim, KeyCursor* cursor);
 	uint m_numFrames;
 	double m_frameIntervalInTicks;
-	mat4 m_globalInverseMatrix;
-	map<string, mat4> m_BoneOffsetMatrixMapping; // maps a bone name to its offset matrix
-	map<string, mat4> m_BoneFinalMatrixMapping; // maps a bone name to its final matrix
+	const aiAnimation* m_indexedAnimation;
+	unordered_map<string, aiNodeAnim*> m_channelIndex; // maps a node name to its channel in m_indexedAnimation
 };
 
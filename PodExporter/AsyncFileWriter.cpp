@@ -0,0 +1,120 @@
+#include "AsyncFileWriter.h"
+#include <chrono>
+#include <algorithm>
+
+namespace pvr {
+namespace assets {
+namespace assetWriters {
+
+namespace {
+double secondsSince(const std::chrono::high_resolution_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+}
+
+AsyncFileWriter::AsyncFileWriter(uint maxPendingBuffers)
+	: m_maxPendingBuffers(std::max(1u, maxPendingBuffers))
+	, m_closing(false)
+	, m_numBytesWritten(0)
+	, m_stallSeconds(0.0)
+	, m_writeSeconds(0.0)
+{
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	close();
+}
+
+bool AsyncFileWriter::open(const std::string& path)
+{
+	close();
+
+	m_fileStream = fstream(path, ios::binary | ios::out | ios::trunc);
+	if (!m_fileStream.is_open()) return false;
+
+	m_closing = false;
+	m_numBytesWritten = 0;
+	m_stallSeconds = 0.0;
+	m_writeSeconds = 0.0;
+	m_ioThread = thread(&AsyncFileWriter::ioLoop, this);
+
+	return true;
+}
+
+void AsyncFileWriter::submit(PODBlockBuffer& buffer)
+{
+	if (buffer.empty()) return;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	unique_lock<mutex> lock(m_mutex);
+	m_freeCondition.wait(lock, [this] { return m_filledBuffers.size() < m_maxPendingBuffers; });
+	m_stallSeconds += secondsSince(startTime);
+
+	m_filledBuffers.push_back(std::move(buffer));
+	buffer.clear();
+
+	// hand back a buffer that has already been written, so its memory gets reused
+	if (!m_freeBuffers.empty())
+	{
+		buffer = std::move(m_freeBuffers.back());
+		m_freeBuffers.pop_back();
+	}
+
+	lock.unlock();
+	m_filledCondition.notify_one();
+}
+
+void AsyncFileWriter::close()
+{
+	if (m_ioThread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_closing = true;
+		}
+		m_filledCondition.notify_one();
+		m_ioThread.join();
+	}
+
+	if (m_fileStream.is_open())
+	{
+		m_fileStream.flush();
+		m_fileStream.close();
+	}
+
+	m_freeBuffers.clear();
+}
+
+void AsyncFileWriter::ioLoop()
+{
+	for (;;)
+	{
+		PODBlockBuffer buffer;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_filledCondition.wait(lock, [this] { return m_closing || !m_filledBuffers.empty(); });
+
+			// closing and everything has been written
+			if (m_filledBuffers.empty()) return;
+
+			buffer = std::move(m_filledBuffers.front());
+			m_filledBuffers.pop_front();
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		m_numBytesWritten += buffer.flushTo(m_fileStream);
+		m_writeSeconds += secondsSince(startTime);
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_freeBuffers.push_back(std::move(buffer));
+		}
+		m_freeCondition.notify_one();
+	}
+}
+
+}
+}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "PODBlockBuffer.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace pvr {
+namespace assets {
+namespace assetWriters {
+
+// Writes filled buffers to a file on a dedicated I/O thread, so that the thread producing
+// the data can keep serializing while the previous buffers are going to disk.
+// At most maxPendingBuffers filled buffers are queued; submit() blocks when the ring is full.
+class AsyncFileWriter
+{
+public:
+	explicit AsyncFileWriter(uint maxPendingBuffers = 4);
+	~AsyncFileWriter();
+
+	AsyncFileWriter(AsyncFileWriter const&) = delete;
+	void operator=(AsyncFileWriter const&) = delete;
+
+	bool open(const std::string& path);
+
+	// queue the buffer for writing, it is swapped with an empty (recycled) buffer
+	void submit(PODBlockBuffer& buffer);
+
+	// wait until every queued buffer has been written, then close the file
+	void close();
+
+	size_t getNumBytesWritten() const { return m_numBytesWritten; }
+	double getStallSeconds() const { return m_stallSeconds; }	// time submit() spent waiting for a free slot
+	double getWriteSeconds() const { return m_writeSeconds; }	// time the I/O thread spent writing
+
+private:
+	void ioLoop();
+
+	fstream m_fileStream;
+	thread m_ioThread;
+	mutex m_mutex;
+	condition_variable m_filledCondition;
+	condition_variable m_freeCondition;
+	deque<PODBlockBuffer> m_filledBuffers;
+	vector<PODBlockBuffer> m_freeBuffers;
+	uint m_maxPendingBuffers;
+	bool m_closing;
+
+	size_t m_numBytesWritten;
+	double m_stallSeconds;
+	double m_writeSeconds;
+};
+
+}
+}
+}
@@ -0,0 +1,148 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_data(NULL)
+	, m_size(0)
+#if defined(_WIN32)
+	, m_fileHandle(INVALID_HANDLE_VALUE)
+	, m_mappingHandle(NULL)
+#else
+	, m_fileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const string& path)
+{
+	close();
+
+	m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_fileHandle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_fileHandle, &fileSize))
+	{
+		close();
+		return false;
+	}
+
+	// an empty file cannot be mapped
+	if (fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	m_mappingHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_mappingHandle)
+	{
+		close();
+		return false;
+	}
+
+	m_data = (char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		close();
+		return false;
+	}
+
+	m_size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = NULL;
+	}
+
+	if (m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = NULL;
+	}
+
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_fileHandle);
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const string& path)
+{
+	close();
+
+	m_fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (m_fileDescriptor < 0) return false;
+
+	struct stat fileInfo;
+	if (fstat(m_fileDescriptor, &fileInfo) != 0)
+	{
+		close();
+		return false;
+	}
+	size_t size = (size_t)fileInfo.st_size;
+
+	// an empty file cannot be mapped
+	if (size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, m_fileDescriptor, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	m_data = (char*)data;
+	m_size = size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		munmap(m_data, m_size);
+		m_data = NULL;
+	}
+
+	if (m_fileDescriptor >= 0)
+	{
+		::close(m_fileDescriptor);
+		m_fileDescriptor = -1;
+	}
+
+	m_size = 0;
+}
+
+#endif
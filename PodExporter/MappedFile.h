@@ -0,0 +1,34 @@
+#pragma once
+#include "Common.h"
+#include <string>
+using namespace std;
+
+// A file opened read-only and mapped into memory.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	// map an existing file for reading
+	bool open(const string& path);
+
+	void close();
+
+	bool isOpen() const { return m_data != NULL; }
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	char* m_data;
+	size_t m_size;
+#if defined(_WIN32)
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	int m_fileDescriptor;
+#endif
+};
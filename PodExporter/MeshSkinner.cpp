@@ -0,0 +1,62 @@
+#include "MeshSkinner.h"
+
+namespace {
+
+// m * (v, w), with the products summed in the same order as glm's vec4 * mat4
+inline vec3 transform(const MeshSkinner::BoneMatrix& m, const vec3& v, float w)
+{
+	return vec3(
+		m.rows[0][0] * v.x + m.rows[0][1] * v.y + m.rows[0][2] * v.z + m.rows[0][3] * w,
+		m.rows[1][0] * v.x + m.rows[1][1] * v.y + m.rows[1][2] * v.z + m.rows[1][3] * w,
+		m.rows[2][0] * v.x + m.rows[2][1] * v.y + m.rows[2][2] * v.z + m.rows[2][3] * w);
+}
+
+}
+
+namespace MeshSkinner
+{
+
+BoneMatrix toBoneMatrix(const mat4& m)
+{
+	BoneMatrix result = { {
+		{ m.a1, m.a2, m.a3, m.a4 },
+		{ m.b1, m.b2, m.b3, m.b4 },
+		{ m.c1, m.c2, m.c3, m.c4 } } };
+	return result;
+}
+
+void skinVertices(MeshData& mesh, const vector<BoneMatrix>& palette, uint first, uint last)
+{
+	bool hasNormals = mesh.normals.size() == mesh.numVertices;
+	bool hasTangents = mesh.tangents.size() == mesh.numVertices;
+	bool hasBitangents = mesh.bitangents.size() == mesh.numVertices;
+
+	for (uint i = first; i < last; ++i)
+	{
+		const VertexBoneData& bones = mesh.bones[i];
+
+		// the rows are blended with fixed size loops the compiler turns into vector operations
+		BoneMatrix blended = {};
+		for (uint k = 0; k < NUM_BONES_PER_VEREX; ++k)
+		{
+			float weight = bones.Weights[k];
+			if (weight == 0.0f) continue;
+
+			const BoneMatrix& bone = palette[bones.IDs[k]];
+			for (uint row = 0; row < 3; ++row)
+			{
+				for (uint column = 0; column < 4; ++column)
+				{
+					blended.rows[row][column] += weight * bone.rows[row][column];
+				}
+			}
+		}
+
+		mesh.positions[i] = transform(blended, mesh.positions[i], 1.0f);
+		if (hasNormals) mesh.normals[i] = transform(blended, mesh.normals[i], 0.0f);
+		if (hasTangents) mesh.tangents[i] = transform(blended, mesh.tangents[i], 0.0f);
+		if (hasBitangents) mesh.bitangents[i] = transform(blended, mesh.bitangents[i], 0.0f);
+	}
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "ModelLoader.h"
+
+// Linear blend skinning of the loaded meshes on the CPU. The bone matrices are gathered once into a palette
+// indexed by bone id, the vertices are then skinned by ranges, which can be done in parallel.
+namespace MeshSkinner
+{
+	// the top three rows of a bone matrix, 4 floats each so that a row is blended as one vector
+	struct BoneMatrix
+	{
+		float rows[3][4];
+	};
+
+	BoneMatrix toBoneMatrix(const mat4& m);
+
+	// Skins the vertices [first, last) of the mesh in place: the positions, and the normals, tangents and
+	// bitangents the mesh has. Each vertex is transformed by the sum of its bone matrices scaled by their
+	// weights, so a vertex without any weight collapses to the origin.
+	void skinVertices(MeshData& mesh, const vector<BoneMatrix>& palette, uint first, uint last);
+}
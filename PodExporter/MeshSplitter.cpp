@@ -0,0 +1,236 @@
+#include "MeshSplitter.h"
+#include "PVRTBoneBatches.h"
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+
+namespace {
+
+// the vertex handed to the bone batching: the bone data, and the vertex it comes from so that
+// the duplicates created by the batching can be traced back
+struct BatchVertex
+{
+	VertexBoneData bones;
+	unsigned int source;
+};
+
+// The triangles being split. The vertex ids are the ones the part limit applies to, for skinned
+// meshes these are the vertices after the bone batching.
+struct TriangleList
+{
+	vector<unsigned int> ids;			// 3 vertex ids per triangle
+	vector<unsigned int> idToSource;	// vertex of the source mesh, per vertex id
+	vector<vec3> centroids;				// per triangle
+};
+
+class VertexCounter
+{
+public:
+	VertexCounter(uint numIds) : m_marks(numIds, 0), m_currentMark(0) {}
+
+	uint count(const TriangleList& list, const vector<uint>& triangles)
+	{
+		++m_currentMark;
+		uint numVertices = 0;
+		for (uint t : triangles)
+		{
+			for (uint k = 0; k < 3; ++k)
+			{
+				uint& mark = m_marks[list.ids[t * 3 + k]];
+				if (mark != m_currentMark)
+				{
+					mark = m_currentMark;
+					++numVertices;
+				}
+			}
+		}
+		return numVertices;
+	}
+
+private:
+	vector<uint> m_marks;
+	uint m_currentMark;
+};
+
+// cut the triangles in two at the median of their centroids along the longest axis, until every piece fits
+void bisect(const TriangleList& list, vector<uint>& triangles, uint maxVertices, VertexCounter& counter, vector<vector<uint>>& pieces)
+{
+	if (triangles.size() <= 1 || counter.count(list, triangles) <= maxVertices)
+	{
+		pieces.push_back(triangles);
+		return;
+	}
+
+	vec3 minCorner = list.centroids[triangles[0]];
+	vec3 maxCorner = minCorner;
+	for (uint t : triangles)
+	{
+		const vec3& c = list.centroids[t];
+		minCorner = vec3(std::min(minCorner.x, c.x), std::min(minCorner.y, c.y), std::min(minCorner.z, c.z));
+		maxCorner = vec3(std::max(maxCorner.x, c.x), std::max(maxCorner.y, c.y), std::max(maxCorner.z, c.z));
+	}
+
+	vec3 extent = maxCorner - minCorner;
+	uint axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+	size_t half = triangles.size() / 2;
+	std::nth_element(triangles.begin(), triangles.begin() + half, triangles.end(),
+		[&list, axis](uint a, uint b) { return list.centroids[a][axis] < list.centroids[b][axis]; });
+
+	vector<uint> lower(triangles.begin(), triangles.begin() + half);
+	vector<uint> upper(triangles.begin() + half, triangles.end());
+	bisect(list, lower, maxVertices, counter, pieces);
+	bisect(list, upper, maxVertices, counter, pieces);
+}
+
+// group the triangles into bone batches, returns false if the batching failed
+bool buildBoneBatches(const MeshData& mesh, uint maxBonesPerBatch, TriangleList& list, vector<vector<uint>>& groups)
+{
+	vector<BatchVertex> vertices(mesh.numVertices);
+	for (uint i = 0; i < mesh.numVertices; ++i)
+	{
+		vertices[i].bones = mesh.bones[i];
+		vertices[i].source = i;
+	}
+
+	vector<unsigned int> indices(mesh.indices);
+	CPVRTBoneBatches boneBatches;
+	int numVerticesOut;
+	char* verticesOut;
+	if (!boneBatches.Create(&numVerticesOut, &verticesOut, indices.data(), mesh.numVertices,
+		reinterpret_cast<const char*>(vertices.data()), sizeof(BatchVertex),
+		offsetof(BatchVertex, bones) + offsetof(VertexBoneData, Weights), EPODDataFloat,
+		offsetof(BatchVertex, bones) + offsetof(VertexBoneData, IDs), EPODDataUnsignedShort,
+		mesh.numFaces, maxBonesPerBatch, NUM_BONES_PER_VEREX))
+	{
+		return false;
+	}
+
+	list.ids = indices;
+	list.idToSource.resize(numVerticesOut);
+	for (int i = 0; i < numVerticesOut; ++i)
+	{
+		memcpy(&list.idToSource[i], verticesOut + i * sizeof(BatchVertex) + offsetof(BatchVertex, source), sizeof(unsigned int));
+	}
+	FREE(verticesOut);
+
+	for (int b = 0; b < boneBatches.nBatchCnt; ++b)
+	{
+		uint first = boneBatches.pnBatchOffset[b];
+		uint last = (b + 1 < boneBatches.nBatchCnt) ? boneBatches.pnBatchOffset[b + 1] : mesh.numFaces;
+		groups.push_back(vector<uint>());
+		for (uint t = first; t < last; ++t)
+		{
+			groups.back().push_back(t);
+		}
+	}
+	boneBatches.Release();
+
+	return true;
+}
+
+MeshData buildPart(const MeshData& mesh, const TriangleList& list, const vector<uint>& triangles, uint partIndex)
+{
+	std::stringstream ss;
+	ss << mesh.name << "-part" << partIndex;
+
+	MeshData part;
+	part.name = ss.str();
+
+	const int unused = -1;
+	vector<int> newIndices(mesh.numVertices, unused);
+	for (uint t : triangles)
+	{
+		for (uint k = 0; k < 3; ++k)
+		{
+			uint source = list.idToSource[list.ids[t * 3 + k]];
+			if (newIndices[source] == unused)
+			{
+				newIndices[source] = (int)part.positions.size();
+				part.positions.push_back(mesh.positions[source]);
+				if (!mesh.texCoords.empty()) part.texCoords.push_back(mesh.texCoords[source]);
+				if (!mesh.normals.empty()) part.normals.push_back(mesh.normals[source]);
+				if (!mesh.tangents.empty()) part.tangents.push_back(mesh.tangents[source]);
+				if (!mesh.bitangents.empty()) part.bitangents.push_back(mesh.bitangents[source]);
+				if (!mesh.colors.empty()) part.colors.push_back(mesh.colors[source]);
+				if (!mesh.bones.empty()) part.bones.push_back(mesh.bones[source]);
+			}
+			part.indices.push_back(newIndices[source]);
+		}
+	}
+
+	part.numVertices = part.positions.size();
+	part.numFaces = triangles.size();
+	part.numIndices = part.indices.size();
+	return part;
+}
+
+}
+
+namespace MeshSplitter
+{
+
+vector<MeshData> split(const MeshData& mesh, uint maxVertices, uint maxBonesPerBatch)
+{
+	vector<MeshData> parts;
+	if (mesh.numFaces == 0) return parts;
+
+	TriangleList list;
+	vector<vector<uint>> groups;
+	bool skinned = maxBonesPerBatch > 0 && mesh.bones.size() == mesh.numVertices && buildBoneBatches(mesh, maxBonesPerBatch, list, groups);
+	if (!skinned)
+	{
+		// a single group with all the triangles, the ids are the vertices themselves
+		list.ids.assign(mesh.indices.begin(), mesh.indices.begin() + mesh.numFaces * 3);
+		list.idToSource.resize(mesh.numVertices);
+		for (uint i = 0; i < mesh.numVertices; ++i)
+			list.idToSource[i] = i;
+
+		groups.assign(1, vector<uint>(mesh.numFaces));
+		for (uint t = 0; t < mesh.numFaces; ++t)
+			groups[0][t] = t;
+	}
+
+	VertexCounter counter(list.idToSource.size());
+	if (groups.size() == 1 && counter.count(list, groups[0]) <= maxVertices) return parts;
+
+	list.centroids.resize(mesh.numFaces);
+	for (uint t = 0; t < mesh.numFaces; ++t)
+	{
+		list.centroids[t] = (mesh.positions[list.idToSource[list.ids[t * 3]]] +
+			mesh.positions[list.idToSource[list.ids[t * 3 + 1]]] +
+			mesh.positions[list.idToSource[list.ids[t * 3 + 2]]]) / 3.0f;
+	}
+
+	// cut the groups that are too big on their own
+	vector<vector<uint>> pieces;
+	for (uint i = 0; i < groups.size(); ++i)
+	{
+		bisect(list, groups[i], maxVertices, counter, pieces);
+	}
+
+	// then merge neighbouring pieces as long as they fit together
+	vector<uint> partTriangles;
+	uint partIndex = 0;
+	for (uint i = 0; i < pieces.size(); ++i)
+	{
+		vector<uint> merged(partTriangles);
+		merged.insert(merged.end(), pieces[i].begin(), pieces[i].end());
+
+		if (!partTriangles.empty() && counter.count(list, merged) > maxVertices)
+		{
+			parts.push_back(buildPart(mesh, list, partTriangles, partIndex++));
+			partTriangles = pieces[i];
+		}
+		else
+		{
+			partTriangles.swap(merged);
+		}
+	}
+	parts.push_back(buildPart(mesh, list, partTriangles, partIndex++));
+
+	if (parts.size() == 1) parts.clear();
+	return parts;
+}
+
+}
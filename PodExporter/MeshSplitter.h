@@ -0,0 +1,12 @@
+#pragma once
+#include "ModelLoader.h"
+
+// Splits meshes that reference too many vertices for 16 bit indices into spatially coherent parts.
+namespace MeshSplitter
+{
+	// Returns the parts of the mesh, each referencing at most maxVertices vertices, or nothing if the mesh
+	// fits as it is. With maxBonesPerBatch > 0 the triangles are first grouped into bone batches the way
+	// CPVRTBoneBatches does it (counting the vertices the batching duplicates), and a batch is only cut
+	// if it does not fit into a part on its own.
+	vector<MeshData> split(const MeshData& mesh, uint maxVertices, uint maxBonesPerBatch = 0);
+}
@@ -1,7 +1,10 @@
 ﻿#include "ModelLoader.h"
-#include "AnimationHelper.h"
+#include "MeshSkinner.h"
+#include "SkeletonEvaluator.h"
+#include "WorkerPool.h"
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
 #include <assimp/postprocess.h>
 
 void ModelLoader::clear()
@@ -70,6 +73,7 @@ vector<ModelDataPtr> ModelLoader::loadModel(const string& fileName, LoadingQuali
 	m_GlobalInverseTransform.Inverse();
 	
 	m_modelDataVector.resize(m_aiScene->mNumMeshes);
+	m_vertexRemaps.assign(m_aiScene->mNumMeshes, vector<unsigned int>());
 
 	for (uint i = 0; i < m_aiScene->mNumMeshes; ++i)
 	{
@@ -168,73 +172,127 @@ string ModelLoader::getMeshNameFromNode(unsigned int meshIndex, aiNode* pNode)
 	return result;
 }
 
+namespace {
+
+// in the vertex remaps, for the vertices that were left out
+const unsigned int c_skippedVertex = 0xffffffff;
+
+// appends the vertices of the kept ranges, [first, last) pairs, a whole range at a time
+template <typename T>
+void appendVertexRanges(const T* source, const vector<pair<uint, uint>>& ranges, uint numKept, vector<T>& out)
+{
+	out.reserve(numKept);
+	for (uint i = 0; i < ranges.size(); ++i)
+	{
+		out.insert(out.end(), source + ranges[i].first, source + ranges[i].second);
+	}
+}
+
+}
+
 void ModelLoader::readVertexAttributes(unsigned int index, const aiMesh* mesh, MeshData& data)
 {
-	// Populate the index buffer
-	vector<unsigned int> unSupportedIndices;
+	// Populate the index buffer, and mark the vertices used by the triangles and by the faces that are not
+	// triangles (points and lines)
+	vector<bool> usedByTriangle(mesh->mNumVertices, false);
+	vector<bool> usedByOtherFace(mesh->mNumVertices, false);
+	uint numUnsupportedFaces = 0;
+	data.indices.reserve(mesh->mNumFaces * 3);
 	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
 	{
 		const aiFace& face = mesh->mFaces[i];
 
 		if (face.mNumIndices != 3)
 		{
-			cout << "Unsupported number of indices per face " << face.mNumIndices << endl;
-
+			++numUnsupportedFaces;
 			for (unsigned int j = 0; j < face.mNumIndices; ++j)
 			{
-				unSupportedIndices.push_back(face.mIndices[j]);
+				usedByOtherFace[face.mIndices[j]] = true;
 			}
 		}
 		else
 		{
-			data.indices.push_back((unsigned int)face.mIndices[0]);
-			data.indices.push_back((unsigned int)face.mIndices[1]);
-			data.indices.push_back((unsigned int)face.mIndices[2]);
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				data.indices.push_back((unsigned int)face.mIndices[j]);
+				usedByTriangle[face.mIndices[j]] = true;
+			}
 		}
 	}
+	if (numUnsupportedFaces > 0)
+	{
+		cout << "Skipped " << numUnsupportedFaces << " faces that are not triangles" << endl;
+	}
 
-	// Populate the vertex attribute vectors
+	// The vertices only the unsupported faces use are left out. The ones kept are copied a range at a time,
+	// and the indices are moved to the compacted vertices.
+	vector<pair<uint, uint>> ranges;
+	vector<unsigned int>& remap = m_vertexRemaps[index];
+	remap.clear();
+	uint numKept = 0;
 	for (uint i = 0; i < mesh->mNumVertices; ++i)
 	{
-		// pass the unsupported vertices
-		bool skip = false;
-		for (uint j = 0; j < unSupportedIndices.size(); ++j)
+		bool skip = usedByOtherFace[i] && !usedByTriangle[i];
+		if (skip)
 		{
-			if (i == unSupportedIndices[j])
+			if (remap.empty())
 			{
-				skip = true;
-				break;
+				remap.resize(mesh->mNumVertices);
+				for (uint j = 0; j < i; ++j)
+					remap[j] = j;
 			}
+			remap[i] = c_skippedVertex;
+			continue;
 		}
 
-		if(skip) continue;
-
-		data.positions.push_back(mesh->mVertices[i]);
+		if (!remap.empty()) remap[i] = numKept;
+		if (ranges.empty() || ranges.back().second != i)
+			ranges.push_back(make_pair(i, i + 1));
+		else
+			++ranges.back().second;
+		++numKept;
+	}
 
-		if (mesh->HasNormals())
+	if (!remap.empty())
+	{
+		for (uint i = 0; i < data.indices.size(); ++i)
 		{
-			data.normals.push_back(mesh->mNormals[i]);
+			data.indices[i] = remap[data.indices[i]];
 		}
+	}
 
-		if (mesh->HasTangentsAndBitangents())
-		{
-			data.tangents.push_back(mesh->mTangents[i]);
-			data.bitangents.push_back(mesh->mBitangents[i]);
-		}
+	// Populate the vertex attribute vectors
+	appendVertexRanges(mesh->mVertices, ranges, numKept, data.positions);
 
-		if (mesh->HasTextureCoords(0))
-		{
-			vec3 texCoord = mesh->mTextureCoords[0][i];
-			data.texCoords.push_back(vec2(texCoord.x, texCoord.y));
-		}
+	if (mesh->HasNormals())
+	{
+		appendVertexRanges(mesh->mNormals, ranges, numKept, data.normals);
+	}
+
+	if (mesh->HasTangentsAndBitangents())
+	{
+		appendVertexRanges(mesh->mTangents, ranges, numKept, data.tangents);
+		appendVertexRanges(mesh->mBitangents, ranges, numKept, data.bitangents);
+	}
 
-		if (mesh->HasVertexColors(0))
+	if (mesh->HasTextureCoords(0))
+	{
+		// the texture coordinates come with 3 components, only u and v are kept
+		data.texCoords.resize(numKept);
+		vec2* texCoord = data.texCoords.data();
+		for (uint i = 0; i < ranges.size(); ++i)
 		{
-			color4D color = mesh->mColors[0][i];
-			data.colors.push_back(color);
+			for (uint j = ranges[i].first; j < ranges[i].second; ++j)
+			{
+				*texCoord++ = vec2(mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y);
+			}
 		}
 	}
 
+	if (mesh->HasVertexColors(0))
+	{
+		appendVertexRanges(mesh->mColors[0], ranges, numKept, data.colors);
+	}
 
 	data.numIndices = data.indices.size();
 	data.numFaces = data.indices.size() / 3;
@@ -265,10 +323,18 @@ void ModelLoader::loadBones(unsigned int index, MeshData& data)
 			boneIndex = m_BoneMapping[boneName];
 		}
 
+		const vector<unsigned int>& remap = m_vertexRemaps[index];
 		for (uint j = 0; j < paiMesh->mBones[i]->mNumWeights; ++j)
 		{
 			uint VertexID = paiMesh->mBones[i]->mWeights[j].mVertexId;
 			float Weight = paiMesh->mBones[i]->mWeights[j].mWeight;
+
+			// the vertex ids are the ones of the aiMesh, before the skipped vertices were left out
+			if (!remap.empty())
+			{
+				VertexID = remap[VertexID];
+				if (VertexID == c_skippedVertex) continue;
+			}
 			data.bones[VertexID].AddBoneData(boneIndex, Weight);
 		}
 	}
@@ -606,49 +672,56 @@ void ModelLoader::applyPoseAtFrame(uint frameIndex)
 {
 	if (m_aiScene->HasAnimations())
 	{
-		AnimationHelper helper(m_GlobalInverseTransform, m_BoneOffsetMatrixMapping);
+		SkeletonEvaluator skeleton(m_aiScene->mRootNode, m_aiScene->mAnimations[0], m_GlobalInverseTransform, m_BoneOffsetMatrixMapping);
+		vector<mat4> boneFinalTransforms;
+		skeleton.evaluateFrame(frameIndex, boneFinalTransforms);
 
-		map<string, mat4> boneFinalTransforms = helper.getBoneFinalTransformsAtFrame(frameIndex, m_aiScene->mAnimations[0], m_aiScene->mRootNode);
+		// the bone of each name, the last one in the hierarchy if several nodes have the same name
+		unordered_map<string, uint> boneIndices;
+		for (uint i = 0; i < skeleton.getBoneNodes().size(); ++i)
+		{
+			boneIndices[string(skeleton.getBoneNodes()[i]->mName.C_Str())] = i;
+		}
 
-		for (uint i = 0; i < m_modelDataVector.size(); ++i)
+		// the bone matrices by bone id (the index of the bone in m_Nodes), the identity for the nodes without one
+		vector<MeshSkinner::BoneMatrix> palette(m_Nodes.size(), MeshSkinner::toBoneMatrix(mat4()));
+		for (uint i = 0; i < m_Nodes.size(); ++i)
 		{
-			if (!m_aiScene->mMeshes[i]->HasBones()) continue;
+			if (!m_Nodes[i]) continue;
 
-			for (uint j = 0; j < m_modelDataVector[i]->meshData.numVertices; ++j)
+			auto it = boneIndices.find(string(m_Nodes[i]->mName.C_Str()));
+			if (it != boneIndices.end())
 			{
-				VertexBoneData boneData = m_modelDataVector[i]->meshData.bones[j];
-
-				glm::mat4 finalM(0.0f);
-				for (uint k = 0; k < NUM_BONES_PER_VEREX; ++k)
-				{
-					float weight = boneData.Weights[k];
-
-					if (weight == 0.0f)
-						continue;
-
-					std::string boneName(m_Nodes[boneData.IDs[k]]->mName.C_Str());
-					glm::mat4 weightedMat = weight * toGLMMatrix4x4(boneFinalTransforms[boneName]);
-
-					finalM += weightedMat;
-				}
-
-				vec3 oldPos = m_modelDataVector[i]->meshData.positions[j];
-				glm::vec4 newPos = glm::vec4(oldPos.x, oldPos.y, oldPos.z, 1.0f) * finalM; // THE ORDER MATTERS!
-				m_modelDataVector[i]->meshData.positions[j] = vec3(newPos.x, newPos.y, newPos.z);
-
-				vec3 oldNormal = m_modelDataVector[i]->meshData.normals[j];
-				glm::vec4 newNormal = glm::vec4(oldNormal.x, oldNormal.y, oldNormal.z, 0.0f) * finalM;
-				m_modelDataVector[i]->meshData.normals[j] = vec3(newNormal.x, newNormal.y, newNormal.z);
+				palette[i] = MeshSkinner::toBoneMatrix(boneFinalTransforms[it->second]);
+			}
+		}
 
-				vec3 oldTagent = m_modelDataVector[i]->meshData.tangents[j];
-				glm::vec4 newTagent = glm::vec4(oldTagent.x, oldTagent.y, oldTagent.z, 0.0f) * finalM;
-				m_modelDataVector[i]->meshData.tangents[j] = vec3(newTagent.x, newTagent.y, newTagent.z);
+		// the vertices of the skinned meshes, cut in ranges so that the big meshes are shared between the threads
+		struct VertexRange
+		{
+			MeshData* mesh;
+			uint first;
+			uint last;
+		};
+		const uint rangeSize = 4096;
+		vector<VertexRange> ranges;
+		for (uint i = 0; i < m_modelDataVector.size(); ++i)
+		{
+			if (!m_aiScene->mMeshes[i]->HasBones()) continue;
 
-				vec3 oldBiTagent = m_modelDataVector[i]->meshData.bitangents[j];
-				glm::vec4 newBiTagent = glm::vec4(oldBiTagent.x, oldBiTagent.y, oldBiTagent.z, 0.0f) * finalM;
-				m_modelDataVector[i]->meshData.bitangents[j] = vec3(newBiTagent.x, newBiTagent.y, newBiTagent.z);
+			MeshData& meshData = m_modelDataVector[i]->meshData;
+			for (uint first = 0; first < meshData.numVertices; first += rangeSize)
+			{
+				VertexRange range = { &meshData, first, std::min(first + rangeSize, meshData.numVertices) };
+				ranges.push_back(range);
 			}
 		}
+
+		WorkerPool workerPool;
+		workerPool.parallelFor((uint)ranges.size(), [&ranges, &palette](uint i)
+		{
+			MeshSkinner::skinVertices(*ranges[i].mesh, palette, ranges[i].first, ranges[i].last);
+		});
 	}
 }
 
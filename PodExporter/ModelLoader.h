@@ -129,6 +129,8 @@ private:
 	MaterialData loadMaterial(const aiMaterial* material);
 	TextureData  loadTexture(const aiMaterial* material);
 	void loadBones(unsigned int index, MeshData& data);
+	// copies the vertices and the triangles of the mesh, leaving out the vertices used only by faces that are
+	// not triangles (the mapping is kept for loadBones)
 	void readVertexAttributes(unsigned int index, const aiMesh* mesh, MeshData& data);
 	string getMeshNameFromNode(unsigned int meshIndex, aiNode* pNode);
 	aiNode* getNode(const char* meshName, vector<aiNode*>& source);
@@ -166,6 +168,7 @@ private:
 	color3D m_sceneAmbientColor;
 	mat4 m_GlobalInverseTransform;
 	vector<ModelDataPtr> m_modelDataVector;
+	vector<vector<unsigned int>> m_vertexRemaps; // per mesh, the loaded index of each aiMesh vertex, empty if none was skipped
 	map<string, unsigned short> m_BoneMapping; // maps a bone name to its index
 	map<string, mat4> m_BoneOffsetMatrixMapping; // maps a bone name to its offset matrix
 	map<string, aiNodeAnim*> m_extraNodeAnimation; // maps an extra node to its animation
@@ -0,0 +1,21 @@
+#include "PODBlockBuffer.h"
+
+namespace pvr {
+namespace assets {
+namespace assetWriters {
+
+size_t PODBlockBuffer::flushTo(fstream& stream)
+{
+	size_t numBytes = m_data.size();
+	if (numBytes > 0)
+	{
+		stream.write(m_data.data(), numBytes);
+		m_data.clear();
+	}
+
+	return numBytes;
+}
+
+}
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Common.h"
+#include <fstream>
+#include <cstring>
+using namespace std;
+
+namespace pvr {
+namespace assets {
+namespace assetWriters {
+
+// A contiguous, growable byte buffer that a POD block (tags + payload) is serialized into.
+// Whole arrays are appended with a single copy, and the buffer is handed to the output
+// stream in one large write instead of one fstream::write call per element.
+class PODBlockBuffer
+{
+public:
+	PODBlockBuffer() {}
+	explicit PODBlockBuffer(size_t capacity) { m_data.reserve(capacity); }
+
+	void write(const void* data, size_t size)
+	{
+		const char* bytes = reinterpret_cast<const char*>(data);
+		m_data.insert(m_data.end(), bytes, bytes + size);
+	}
+
+	void append(const PODBlockBuffer& other) { write(other.data(), other.size()); }
+
+	void reserve(size_t capacity) { m_data.reserve(capacity); }
+	void clear() { m_data.clear(); }
+
+	const char* data() const { return m_data.data(); }
+	size_t size() const { return m_data.size(); }
+	bool empty() const { return m_data.empty(); }
+
+	// write the whole buffer to the stream and empty it, returns the number of bytes written
+	size_t flushTo(fstream& stream);
+
+private:
+	vector<char> m_data;
+};
+
+}
+}
+}
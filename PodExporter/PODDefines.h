@@ -169,6 +169,7 @@ namespace pvr {
 			case DataType::Int16:
 			case DataType::Int16Norm:
 			case DataType::UInt16:
+			case DataType::UInt16Norm:
 				return 2;
 			case DataType::UInt8:
 			case DataType::UInt8Norm:
@@ -196,6 +197,7 @@ namespace pvr {
 			case DataType::Int16:
 			case DataType::Int16Norm:
 			case DataType::UInt16:
+			case DataType::UInt16Norm:
 			case DataType::Fixed16_16:
 			case DataType::Int8:
 			case DataType::Int8Norm:
@@ -395,6 +397,7 @@ namespace pvr {
 			e_meshMaxNumBonesPerBatch,
 			e_meshNumBoneBatches,
 			e_meshUnpackMatrix,
+			e_meshUVWUnpack,		// not in the original format: offset (u, v) and scale (u, v) of remapped normalized UVs, uv = offset + scale * stored
 
 			// Light
 			e_lightTargetObjectIndex = 7000,
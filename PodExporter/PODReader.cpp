@@ -0,0 +1,223 @@
+#include "PODReader.h"
+#include <iostream>
+
+namespace pvr {
+namespace assets {
+namespace assetReaders {
+
+bool PODReader::open(const std::string& path)
+{
+	close();
+
+	if (!m_file.open(path))
+	{
+		std::cout << "\nCannot open file: " << path;
+		return false;
+	}
+
+	if (!buildIndex())
+	{
+		std::cout << "\nInvalid POD file: " << path;
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void PODReader::close()
+{
+	m_file.close();
+	m_entries.clear();
+	m_firstTopLevelEntry = -1;
+	m_sceneEntry = -1;
+}
+
+bool PODReader::isBlockIdentifier(uint32 identifier) const
+{
+	// these tags contain further tags, whatever length their start tag says
+	switch (identifier)
+	{
+	case pod::Scene:
+	case pod::e_sceneCamera:
+	case pod::e_sceneLight:
+	case pod::e_sceneMesh:
+	case pod::e_sceneNode:
+	case pod::e_sceneTexture:
+	case pod::e_sceneMaterial:
+	case pod::e_meshVertexIndexList:
+	case pod::e_meshVertexList:
+	case pod::e_meshNormalList:
+	case pod::e_meshTangentList:
+	case pod::e_meshBinormalList:
+	case pod::e_meshUVWList:
+	case pod::e_meshVertexColorList:
+	case pod::e_meshBoneIndexList:
+	case pod::e_meshBoneWeightList:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool PODReader::buildIndex()
+{
+	const char* data = m_file.data();
+	const size_t fileSize = m_file.size();
+	size_t position = 0;
+
+	vector<int32> openTags;			// tags whose end tag has not been reached yet
+	vector<int32> lastChild(1, -1);	// last tag added at each nesting level
+
+	while (position + 8 <= fileSize)
+	{
+		uint32 tag, length;
+		memcpy(&tag, data + position, 4);
+		memcpy(&length, data + position + 4, 4);
+		position += 8;
+
+		uint32 identifier = tag & ~pod::c_endTagMask;
+
+		if (tag & pod::c_endTagMask)
+		{
+			if (openTags.empty() || m_entries[openTags.back()].identifier != identifier) return false;
+
+			TagEntry& entry = m_entries[openTags.back()];
+			if (entry.isBlock)
+			{
+				entry.dataSize = position - 8 - entry.dataOffset;
+			}
+
+			openTags.pop_back();
+			lastChild.pop_back();
+			continue;
+		}
+
+		TagEntry entry;
+		entry.identifier = identifier;
+		entry.length = length;
+		entry.dataOffset = position;
+		entry.dataSize = 0;
+		entry.parent = openTags.empty() ? -1 : openTags.back();
+		entry.firstChild = -1;
+		entry.nextSibling = -1;
+		entry.isBlock = isBlockIdentifier(identifier);
+
+		if (!entry.isBlock)
+		{
+			if (position + length > fileSize) return false;
+			entry.dataSize = length;
+			position += length;
+		}
+
+		// link it to its siblings
+		int32 entryIndex = (int32)m_entries.size();
+		int32 previous = lastChild.back();
+		if (previous >= 0)
+			m_entries[previous].nextSibling = entryIndex;
+		else if (entry.parent >= 0)
+			m_entries[entry.parent].firstChild = entryIndex;
+		else
+			m_firstTopLevelEntry = entryIndex;
+		lastChild.back() = entryIndex;
+
+		m_entries.push_back(entry);
+		openTags.push_back(entryIndex);
+		lastChild.push_back(-1);
+	}
+
+	if (!openTags.empty() || position != fileSize) return false;
+
+	m_sceneEntry = findChild(-1, pod::Scene);
+	return m_sceneEntry >= 0;
+}
+
+vector<uint32> PODReader::findChildren(int32 parent, uint32 identifier) const
+{
+	vector<uint32> result;
+	int32 child = parent >= 0 ? m_entries[parent].firstChild : m_firstTopLevelEntry;
+	while (child >= 0)
+	{
+		if (m_entries[child].identifier == identifier)
+		{
+			result.push_back(child);
+		}
+		child = m_entries[child].nextSibling;
+	}
+
+	return result;
+}
+
+int32 PODReader::findChild(int32 parent, uint32 identifier) const
+{
+	int32 child = parent >= 0 ? m_entries[parent].firstChild : m_firstTopLevelEntry;
+	while (child >= 0)
+	{
+		if (m_entries[child].identifier == identifier)
+		{
+			return child;
+		}
+		child = m_entries[child].nextSibling;
+	}
+
+	return -1;
+}
+
+PODSpan<char> PODReader::getData(uint32 entryIndex) const
+{
+	const TagEntry& entry = m_entries[entryIndex];
+	return PODSpan<char>(m_file.data() + entry.dataOffset, entry.dataSize);
+}
+
+PODSpan<char> PODReader::getInterleavedData(uint32 meshEntry) const
+{
+	int32 entry = findChild(meshEntry, pod::e_meshInterleavedDataList);
+	return entry >= 0 ? getData(entry) : PODSpan<char>();
+}
+
+PODSpan<char> PODReader::getAttributeData(uint32 meshEntry, uint32 listIdentifier) const
+{
+	// the entries are in file order, so a list holds its own data if it comes before the interleaved data
+	int32 list = findChild(meshEntry, listIdentifier);
+	int32 interleavedList = findChild(meshEntry, pod::e_meshInterleavedDataList);
+	if (list < 0 || (interleavedList >= 0 && list > interleavedList)) return PODSpan<char>();
+
+	int32 entry = findChild(list, pod::e_blockData);
+	return entry >= 0 ? getData(entry) : PODSpan<char>();
+}
+
+PODSpan<char> PODReader::getIndexData(uint32 meshEntry, DataType::Enum& type) const
+{
+	type = DataType::None;
+
+	int32 indexList = findChild(meshEntry, pod::e_meshVertexIndexList);
+	if (indexList < 0) return PODSpan<char>();
+
+	uint32 dataType = DataType::None;
+	readValue(indexList, pod::e_blockDataType, dataType);
+	type = (DataType::Enum)dataType;
+
+	int32 entry = findChild(indexList, pod::e_blockData);
+	return entry >= 0 ? getData(entry) : PODSpan<char>();
+}
+
+PODSpan<char> PODReader::getAnimationMatrices(uint32 nodeEntry) const
+{
+	int32 entry = findChild(nodeEntry, pod::e_nodeAnimationMatrix);
+	return entry >= 0 ? getData(entry) : PODSpan<char>();
+}
+
+bool PODReader::readAnimationMatrices(uint32 nodeEntry, vector<float32>& matrices) const
+{
+	PODSpan<char> data = getAnimationMatrices(nodeEntry);
+	if (data.empty()) return false;
+
+	// the payload is not necessarily 4-byte aligned in the file (strings have any length), so copy it
+	matrices.resize(data.count / sizeof(float32));
+	if (!matrices.empty()) memcpy(matrices.data(), data.data, matrices.size() * sizeof(float32));
+	return true;
+}
+
+}
+}
+}
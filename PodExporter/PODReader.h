@@ -0,0 +1,105 @@
+#pragma once
+#include "PODDefines.h"
+#include "MappedFile.h"
+#include <cstring>
+using std::vector;
+
+namespace pvr {
+namespace assets {
+namespace assetReaders {
+
+// A view over memory owned by someone else (here, the mapped POD file)
+template <typename T>
+struct PODSpan
+{
+	const T* data;
+	size_t count;
+
+	PODSpan() : data(NULL), count(0) {}
+	PODSpan(const T* d, size_t c) : data(d), count(c) {}
+
+	bool empty() const { return count == 0; }
+	const T& operator[](size_t i) const { return data[i]; }
+};
+
+// Reads a POD file without copying it: the file is memory mapped, the start/end tags are walked
+// once to build an index of every block, and the payloads are handed out as spans into the mapping.
+class PODReader
+{
+public:
+	struct TagEntry
+	{
+		uint32 identifier;
+		uint32 length;		// length stored in the start tag
+		size_t dataOffset;	// offset of the payload (or of the first nested tag) in the file
+		size_t dataSize;	// size of the payload, for blocks this covers all the nested tags
+		int32 parent;		// index of the enclosing block, -1 at the top level
+		int32 firstChild;	// index of the first nested tag, -1 if there is none
+		int32 nextSibling;	// index of the next tag in the same block, -1 if there is none
+		bool isBlock;		// true if the tag contains further tags rather than data
+	};
+
+	PODReader() : m_firstTopLevelEntry(-1), m_sceneEntry(-1) {}
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return m_file.isOpen(); }
+
+	// the whole index, in file order
+	const vector<TagEntry>& getEntries() const { return m_entries; }
+
+	// indices of the direct children of the entry with the given identifier (parent -1 means the top level)
+	vector<uint32> findChildren(int32 parent, uint32 identifier) const;
+	int32 findChild(int32 parent, uint32 identifier) const;
+
+	PODSpan<char> getData(uint32 entryIndex) const;
+
+	template <typename T>
+	bool readValue(int32 parent, uint32 identifier, T& value) const
+	{
+		int32 entry = findChild(parent, identifier);
+		if (entry < 0 || m_entries[entry].dataSize < sizeof(T)) return false;
+		memcpy(&value, m_file.data() + m_entries[entry].dataOffset, sizeof(T));
+		return true;
+	}
+
+	/*
+	*	Scene level accessors
+	*/
+	int32 getSceneEntry() const { return m_sceneEntry; }
+	vector<uint32> getMeshEntries() const { return findChildren(m_sceneEntry, pod::e_sceneMesh); }
+	vector<uint32> getNodeEntries() const { return findChildren(m_sceneEntry, pod::e_sceneNode); }
+	vector<uint32> getMaterialEntries() const { return findChildren(m_sceneEntry, pod::e_sceneMaterial); }
+
+	/*
+	*	Mesh payloads
+	*/
+	PODSpan<char> getInterleavedData(uint32 meshEntry) const;
+	// the data of an attribute list holding its own vertex data, as with split vertex streams (the lists found
+	// before the interleaved data list), empty if the attribute is an offset into the interleaved data
+	PODSpan<char> getAttributeData(uint32 meshEntry, uint32 listIdentifier) const;
+	// the raw index data, its element type (UInt16 or UInt32) is returned in type
+	PODSpan<char> getIndexData(uint32 meshEntry, DataType::Enum& type) const;
+
+	/*
+	*	Node payloads
+	*/
+	// the raw matrix data, 16 floats per frame of animation. The payload is not necessarily 4-byte aligned
+	// in the file, so memcpy the floats out of it (or use readAnimationMatrices) rather than casting it.
+	PODSpan<char> getAnimationMatrices(uint32 nodeEntry) const;
+	// copies the matrices into matrices, false if the node is not animated
+	bool readAnimationMatrices(uint32 nodeEntry, vector<float32>& matrices) const;
+
+private:
+	bool buildIndex();
+	bool isBlockIdentifier(uint32 identifier) const;
+
+	MappedFile m_file;
+	vector<TagEntry> m_entries;
+	int32 m_firstTopLevelEntry;
+	int32 m_sceneEntry;
+};
+
+}
+}
+}
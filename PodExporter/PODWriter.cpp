@@ -6,19 +6,28 @@ to '\r\n', which produces one more byte than expected.                  */
 
 #include "PODWriter.h"
 #include "PVRTBoneBatches.h"
+#include "PVRTVertex.h"
 #include "AnimationHelper.h"
+#include "VertexCacheOptimizer.h"
+#include "MeshSplitter.h"
+#include "VertexInterleaver.h"
 #include <cstdio>
+#include <cstddef>
 #include <algorithm>
+#include <chrono>
 
 #define  MAX_NUM_BONES_PER_BATCH 8
+#define  MAX_NUM_VERTICES_16BIT_INDICES 0x10000
+#define  FLUSH_THRESHOLD_IN_BYTES (4 * 1024 * 1024) // hand the buffer to the file stream once it is this large
 #define HISTORY_MESSAGE "Hello POD!" // Put your messages here...
 
 namespace { // LOCAL FUNCTIONS
 using namespace pvr;
 using namespace assets;
+using namespace assetWriters;
 
 template <typename T>
-void writeBytes(fstream& stream, T& data, streamsize size = 0)
+void writeBytes(PODBlockBuffer& stream, const T& data, streamsize size = 0)
 {
 	if (size > 0)
 		stream.write(reinterpret_cast<const char *>(&data), size);
@@ -27,23 +36,27 @@ void writeBytes(fstream& stream, T& data, streamsize size = 0)
 }
 
 template <typename T>
-void writeByteArray(fstream& stream, T* data, uint32 count)
+void writeByteArray(PODBlockBuffer& stream, const T* data, uint32 count)
 {
-	for (uint32 i = 0; i < count; ++i)
-	{
-		writeBytes(stream, data[i]);
-	}
+	// the elements are contiguous, copy them in one go
+	stream.write(data, count * sizeof(T));
 }
 
 template <typename T>
-void write4Bytes(fstream& stream, T& data)
+void write4Bytes(PODBlockBuffer& stream, const T& data)
 {
 	writeBytes(stream, data, 4);
 }
 
 template <typename T>
-void write4ByteArray(fstream& stream, T* data, uint32 count)
+void write4ByteArray(PODBlockBuffer& stream, const T* data, uint32 count)
 {
+	if (sizeof(T) == 4)
+	{
+		stream.write(data, count * 4);
+		return;
+	}
+
 	for (uint32 i = 0; i < count; ++i)
 	{
 		write4Bytes(stream, data[i]);
@@ -51,14 +64,20 @@ void write4ByteArray(fstream& stream, T* data, uint32 count)
 }
 
 template <typename T>
-void write2Bytes(fstream& stream, T& data)
+void write2Bytes(PODBlockBuffer& stream, const T& data)
 {
 	writeBytes(stream, data, 2);
 }
 
 template <typename T>
-void write2ByteArray(fstream& stream, T* data, uint32 count)
+void write2ByteArray(PODBlockBuffer& stream, const T* data, uint32 count)
 {
+	if (sizeof(T) == 2)
+	{
+		stream.write(data, count * 2);
+		return;
+	}
+
 	for (uint32 i = 0; i < count; ++i)
 	{
 		write2Bytes(stream, data[i]);
@@ -66,33 +85,30 @@ void write2ByteArray(fstream& stream, T* data, uint32 count)
 }
 
 template <typename T>
-void writeByteArrayFromVector(fstream& stream, vector<T>& data)
+void writeByteArrayFromVector(PODBlockBuffer& stream, const vector<T>& data)
 {
 	writeByteArray<T>(stream, data.data(), data.size());
 }
 
 template <typename T>
-void write2ByteArrayFromVector(fstream& stream, vector<T>& data)
+void write2ByteArrayFromVector(PODBlockBuffer& stream, const vector<T>& data)
 {
 	write2ByteArray<T>(stream, data.data(), data.size());
 }
 
 template <typename T>
-void write4ByteArrayFromVector(fstream& stream, vector<T>& data)
+void write4ByteArrayFromVector(PODBlockBuffer& stream, const vector<T>& data)
 {
 	write4ByteArray<T>(stream, data.data(), data.size());
 }
 
-void writeByteArrayFromeString(fstream& stream, std::string& data)
+void writeByteArrayFromeString(PODBlockBuffer& stream, const std::string& data)
 {
-	writeByteArray(stream, data.c_str(), data.length());
-
-	// write the null terminator
-	const char* end = "\0";
-	writeBytes(stream, *end, 1);
+	// write the string together with its null terminator
+	stream.write(data.c_str(), data.length() + 1);
 }
 
-void writeTag(fstream& stream, uint32 tagMask, uint32 identifier, uint32 dataLength)
+void writeTag(PODBlockBuffer& stream, uint32 tagMask, uint32 identifier, uint32 dataLength)
 {
 	uint32 halfTag = identifier | tagMask;
 	write4Bytes(stream, halfTag);
@@ -100,7 +116,7 @@ void writeTag(fstream& stream, uint32 tagMask, uint32 identifier, uint32 dataLen
 }
 
 template <typename T>
-void writeVertexIndexData(fstream& stream, std::vector<T>& data)
+void writeVertexIndexData(PODBlockBuffer& stream, std::vector<T>& data)
 {
 	// write block data type (UInt32 or UInt16)
 	writeTag(stream, pod::c_startTagMask, pod::e_blockDataType, 4);
@@ -131,171 +147,1162 @@ void writeVertexIndexData(fstream& stream, std::vector<T>& data)
 	writeTag(stream, pod::c_endTagMask, pod::e_blockData, 0);
 }
 
+void writeVertexIndexList(PODBlockBuffer& stream, const vector<uint32>& indices, uint32 numVertices, bool force32BitIndices)
+{
+	// 16 bit indices are enough as long as every vertex can be addressed with them
+	if (!force32BitIndices && numVertices <= MAX_NUM_VERTICES_16BIT_INDICES)
+	{
+		vector<uint16> shortIndices(indices.begin(), indices.end());
+		writeTag(stream, pod::c_startTagMask, pod::e_meshVertexIndexList, sizeof(uint16) * shortIndices.size());
+		writeVertexIndexData<uint16>(stream, shortIndices);
+	}
+	else
+	{
+		vector<uint32> longIndices(indices);
+		writeTag(stream, pod::c_startTagMask, pod::e_meshVertexIndexList, sizeof(uint32) * longIndices.size());
+		writeVertexIndexData<uint32>(stream, longIndices);
+	}
+	writeTag(stream, pod::c_endTagMask, pod::e_meshVertexIndexList, 0);
+}
+
 template <typename T>
-void writeVertexData(fstream& stream, pvr::DataType::Enum type, uint32 numComponents, uint32 stride, std::vector<T>& data)
+void writeVertexData(PODBlockBuffer& stream, pvr::DataType::Enum type, uint32 numComponents, uint32 stride, std::vector<T>& data)
+{
+	// write block data type
+	writeTag(stream, pod::c_startTagMask, pod::e_blockDataType, 4);
+	write4Bytes(stream, type);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockDataType, 0);
+
+	// write num components (e.g. position buffer, it has x, y, z, so numComponents = 3)
+	writeTag(stream, pod::c_startTagMask, pod::e_blockNumComponents, 4);
+	write4Bytes(stream, numComponents);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockNumComponents, 0);
+
+	// write stride: The distance, in bytes, from one array member to the next. 
+	writeTag(stream, pod::c_startTagMask, pod::e_blockStride, 4);
+	write4Bytes(stream, stride);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockStride, 0);
+
+	// write the block data buffer
+	writeTag(stream, pod::c_startTagMask, pod::e_blockData, data.size() * sizeof(T));
+
+	switch (DataType::size(type))
+	{
+	case 1:
+		writeByteArrayFromVector<T>(stream, data);
+		break;
+	case 2:
+		write2ByteArrayFromVector<T>(stream, data);
+		break;
+	case 4:
+		write4ByteArrayFromVector<T>(stream, data);
+		break;
+	}
+
+	writeTag(stream, pod::c_endTagMask, pod::e_blockData, 0);
+}
+
+void writeVertexAttributeOffset(PODBlockBuffer& stream, pvr::DataType::Enum type, uint32 numComponents, uint32 stride, uint32 offset)
 {
 	// write block data type
 	writeTag(stream, pod::c_startTagMask, pod::e_blockDataType, 4);
 	write4Bytes(stream, type);
 	writeTag(stream, pod::c_endTagMask, pod::e_blockDataType, 0);
 
-	// write num components (e.g. position buffer, it has x, y, z, so numComponents = 3)
-	writeTag(stream, pod::c_startTagMask, pod::e_blockNumComponents, 4);
-	write4Bytes(stream, numComponents);
-	writeTag(stream, pod::c_endTagMask, pod::e_blockNumComponents, 0);
+	// write num components (e.g. position buffer, it has x, y, z, so numComponents = 3)
+	writeTag(stream, pod::c_startTagMask, pod::e_blockNumComponents, 4);
+	write4Bytes(stream, numComponents);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockNumComponents, 0);
+
+	// write stride: The distance, in bytes, from one array member to the next. 
+	writeTag(stream, pod::c_startTagMask, pod::e_blockStride, 4);
+	write4Bytes(stream, stride);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockStride, 0);
+
+	// write the block data buffer (here, we write the offset of this vertex attribute)
+	writeTag(stream, pod::c_startTagMask, pod::e_blockData, 4);
+	write4Bytes(stream, offset);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockData, 0);
+}
+
+// an attribute list holding its own vertex data rather than an offset into the interleaved data
+void writeVertexAttributeData(PODBlockBuffer& stream, pvr::DataType::Enum type, uint32 numComponents, uint32 stride, const vector<char>& data)
+{
+	writeTag(stream, pod::c_startTagMask, pod::e_blockDataType, 4);
+	write4Bytes(stream, type);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockDataType, 0);
+
+	writeTag(stream, pod::c_startTagMask, pod::e_blockNumComponents, 4);
+	write4Bytes(stream, numComponents);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockNumComponents, 0);
+
+	writeTag(stream, pod::c_startTagMask, pod::e_blockStride, 4);
+	write4Bytes(stream, stride);
+	writeTag(stream, pod::c_endTagMask, pod::e_blockStride, 0);
+
+	writeTag(stream, pod::c_startTagMask, pod::e_blockData, (uint32)data.size());
+	writeByteArray(stream, data.data(), (uint32)data.size());
+	writeTag(stream, pod::c_endTagMask, pod::e_blockData, 0);
+}
+
+// one attribute of the interleaved vertex data
+struct VertexAttribute
+{
+	uint32 identifier;			// the list describing it (pod::e_meshVertexList, pod::e_meshNormalList...)
+	DataType::Enum type;
+	uint32 numComponents;
+	uint32 offset;				// in bytes, from the start of the vertex
+};
+
+uint32 getVertexAttributeSize(DataType::Enum type, uint32 numComponents)
+{
+	// the packed formats hold all the components in a single value
+	return DataType::componentCount(type) > 1 ? DataType::size(type) : DataType::size(type) * numComponents;
+}
+
+// appends an attribute at the given offset, returns the offset of the next one
+uint32 addVertexAttribute(vector<VertexAttribute>& attributes, uint32 identifier, DataType::Enum type, uint32 numComponents, uint32 offset)
+{
+	VertexAttribute attribute = { identifier, type, numComponents, offset };
+	attributes.push_back(attribute);
+	return offset + getVertexAttributeSize(type, numComponents);
+}
+
+// the stride padded to a multiple of the alignment
+uint32 alignStride(uint32 stride, uint32 alignment)
+{
+	return (stride + alignment - 1) / alignment * alignment;
+}
+
+const VertexAttribute* findVertexAttribute(const vector<VertexAttribute>& attributes, uint32 identifier)
+{
+	for (uint i = 0; i < attributes.size(); ++i)
+	{
+		if (attributes[i].identifier == identifier) return &attributes[i];
+	}
+	return NULL;
+}
+
+// fill one attribute of every vertex of the interleaved data. The source values are copied as they are
+// if they already have the right type, otherwise they are read as floats and converted.
+void encodeVertexAttribute(vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const void* source, DataType::Enum sourceType, uint32 sourceStride)
+{
+	VertexInterleaver::writeAttribute(vertexData.data() + attribute.offset, stride, vertexData.size() / stride,
+		attribute.type, attribute.numComponents, source, sourceType, sourceStride);
+}
+
+// Bone weights in a normalized format are rounded so that they still add up to exactly 1 once read back:
+// the weights are normalized and rounded down, and the steps left go to the ones that lost the most.
+void encodeBoneWeights(vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const vector<VertexBoneData>& bones)
+{
+	if (!DataType::isNormalised(attribute.type))
+	{
+		encodeVertexAttribute(vertexData, stride, attribute, bones[0].Weights, DataType::Float32, sizeof(VertexBoneData));
+		return;
+	}
+
+	float steps = attribute.type == DataType::UInt8Norm ? 255.0f : 65535.0f;
+	for (uint i = 0; i < bones.size(); ++i)
+	{
+		const float* weights = bones[i].Weights;
+		float sum = 0.0f;
+		for (uint k = 0; k < NUM_BONES_PER_VEREX; ++k)
+			sum += weights[k];
+
+		PVRTVECTOR4f quantized = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float* values = &quantized.x;
+		if (sum > 0.0f)
+		{
+			float remainders[NUM_BONES_PER_VEREX];
+			int numStepsLeft = (int)steps;
+			for (uint k = 0; k < NUM_BONES_PER_VEREX; ++k)
+			{
+				float scaled = weights[k] / sum * steps;
+				values[k] = floorf(scaled);
+				remainders[k] = weights[k] > 0.0f ? scaled - values[k] : -1.0f;
+				numStepsLeft -= (int)values[k];
+			}
+
+			for (; numStepsLeft > 0; --numStepsLeft)
+			{
+				float* largest = std::max_element(remainders, remainders + NUM_BONES_PER_VEREX);
+				if (*largest < 0.0f) break;
+				values[largest - remainders] += 1.0f;
+				*largest = -1.0f;
+			}
+
+			for (uint k = 0; k < NUM_BONES_PER_VEREX; ++k)
+				values[k] /= steps;
+		}
+
+		PVRTVertexWrite(&vertexData[i * stride + attribute.offset], (EPVRTDataType)attribute.type, attribute.numComponents, &quantized);
+	}
+}
+
+// the skin data handed to the bone batching: the weights as they are written, the bone ids as they are loaded
+// (node indices, only made small enough for the palette index formats by the batching) and the vertex it comes from
+struct BatchVertex
+{
+	char weights[NUM_BONES_PER_VEREX * sizeof(float)];
+	unsigned short ids[NUM_BONES_PER_VEREX];
+	unsigned int source;
+};
+
+// angle in degrees between two unit vectors. atan2 rather than acos, which has no precision left for the
+// tiny angles of the 16 bit formats.
+float calcAngle(const vec3& a, const vec3& b)
+{
+	return atan2f((a ^ b).Length(), a * b) * 180.0f / glm::pi<float>();
+}
+
+// Directions are normalized before they are packed. In the 8 and 10 bit formats rounding each component on its
+// own is noticeably off, so the neighbours of the rounded value are tried as well and the one that points
+// closest to the original direction (once read back and renormalized) is kept.
+// Returns the largest angle, in degrees, between a direction and its packed value.
+float encodeDirections(vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const vector<vec3>& directions)
+{
+	if (attribute.type == DataType::Float32)
+	{
+		encodeVertexAttribute(vertexData, stride, attribute, directions.data(), DataType::Float32, sizeof(vec3));
+		return 0.0f;
+	}
+
+	float steps = attribute.type == DataType::DEC3N ? 511.0f : (attribute.type == DataType::Int8Norm ? 127.0f : 32767.0f);
+	bool searchNeighbours = attribute.type != DataType::Int16Norm;
+	EPVRTDataType type = (EPVRTDataType)attribute.type;
+
+	float maxError = 0.0f;
+	for (uint i = 0; i < directions.size(); ++i)
+	{
+		char* dst = &vertexData[i * stride + attribute.offset];
+
+		vec3 direction = directions[i];
+		float length = direction.Length();
+		if (length > 0.0f) direction /= length;
+
+		PVRTVECTOR4f rounded = { floorf(direction.x * steps + 0.5f), floorf(direction.y * steps + 0.5f), floorf(direction.z * steps + 0.5f), 0.0f };
+		float bestDot = -2.0f;
+		vec3 bestDirection;
+		int range = searchNeighbours ? 1 : 0;
+		for (int dx = -range; dx <= range; ++dx)
+		{
+			for (int dy = -range; dy <= range; ++dy)
+			{
+				for (int dz = -range; dz <= range; ++dz)
+				{
+					PVRTVECTOR4f candidate = { (rounded.x + dx) / steps, (rounded.y + dy) / steps, (rounded.z + dz) / steps, 0.0f };
+					char encoded[8];
+					PVRTVertexWrite(encoded, type, 3, &candidate);
+
+					PVRTVECTOR4f decoded;
+					PVRTVertexRead(&decoded, encoded, type, 3);
+					vec3 unpacked(decoded.x, decoded.y, decoded.z);
+					float unpackedLength = unpacked.Length();
+					float dot = unpackedLength > 0.0f ? (unpacked * direction) / unpackedLength : -1.0f;
+					if (dot > bestDot)
+					{
+						bestDot = dot;
+						bestDirection = unpacked;
+						memcpy(dst, encoded, getVertexAttributeSize(attribute.type, 3));
+					}
+				}
+			}
+		}
+
+		if (length > 0.0f)
+		{
+			bestDirection.Normalize();
+			maxError = std::max(maxError, calcAngle(bestDirection, direction));
+		}
+	}
+
+	return maxError;
+}
+
+// The tangents with the handedness of the frame in w: the bitangent is cross(normal, tangent) * w.
+// Returns the largest angle, in degrees, between a tangent and its packed value.
+float encodeTangentsWithSign(vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const MeshData& meshData)
+{
+	VertexAttribute direction = attribute;
+	direction.numComponents = 3;
+	float maxError = encodeDirections(vertexData, stride, direction, meshData.tangents);
+
+	uint32 signOffset = attribute.offset + 3 * DataType::size(attribute.type);
+	for (uint i = 0; i < meshData.tangents.size(); ++i)
+	{
+		PVRTVECTOR4f sign = { (meshData.normals[i] ^ meshData.tangents[i]) * meshData.bitangents[i] < 0.0f ? -1.0f : 1.0f, 0.0f, 0.0f, 0.0f };
+		PVRTVertexWrite(&vertexData[i * stride + signOffset], (EPVRTDataType)attribute.type, 1, &sign);
+	}
+
+	return maxError;
+}
+
+// The whole tangent frame as one rotation (a "QTangent"): the quaternion (x, y, z, w) turns the x, y and z axes
+// into the tangent, the bitangent and the normal. The frame is made orthonormal around the normal, and the
+// handedness is the sign of w: the bitangent is cross(normal, tangent), negated if w is negative.
+// Returns the largest angle, in degrees, between a normal or a tangent and the one read back.
+float encodeQTangents(vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const MeshData& meshData)
+{
+	// w is kept away from 0 so that its sign survives the quantization
+	float bias = attribute.type == DataType::Int8Norm ? 1.0f / 127.0f : (attribute.type == DataType::Int16Norm ? 1.0f / 32767.0f : 1e-6f);
+
+	float maxError = 0.0f;
+	for (uint i = 0; i < meshData.normals.size(); ++i)
+	{
+		vec3 normal = meshData.normals[i];
+		if (normal.Length() == 0.0f) normal = vec3(0.0f, 0.0f, 1.0f);
+		normal.Normalize();
+
+		vec3 tangent = meshData.tangents[i] - normal * (normal * meshData.tangents[i]);
+		if (tangent.Length() < 1e-6f)
+		{
+			// no usable tangent: any direction perpendicular to the normal
+			vec3 axis = fabsf(normal.x) < 0.9f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f);
+			tangent = axis - normal * (normal * axis);
+		}
+		tangent.Normalize();
+		vec3 bitangent = normal ^ tangent;
+
+		mat3 frame(tangent.x, bitangent.x, normal.x,
+			tangent.y, bitangent.y, normal.y,
+			tangent.z, bitangent.z, normal.z);
+		quat rotation(frame);
+		rotation.Normalize();
+		if (rotation.w < 0.0f) rotation = quat(-rotation.w, -rotation.x, -rotation.y, -rotation.z);
+		if (rotation.w < bias)
+		{
+			float scale = sqrtf((1.0f - bias * bias) / (rotation.x * rotation.x + rotation.y * rotation.y + rotation.z * rotation.z));
+			rotation = quat(bias, rotation.x * scale, rotation.y * scale, rotation.z * scale);
+		}
+
+		float handedness = bitangent * meshData.bitangents[i] < 0.0f ? -1.0f : 1.0f;
+		PVRTVECTOR4f value = { rotation.x * handedness, rotation.y * handedness, rotation.z * handedness, rotation.w * handedness };
+		char* dst = &vertexData[i * stride + attribute.offset];
+		PVRTVertexWrite(dst, (EPVRTDataType)attribute.type, 4, &value);
+
+		PVRTVECTOR4f decoded;
+		PVRTVertexRead(&decoded, dst, (EPVRTDataType)attribute.type, 4);
+		quat unpacked(decoded.w, decoded.x, decoded.y, decoded.z);
+		unpacked.Normalize();
+		mat3 unpackedFrame = unpacked.GetMatrix();
+		maxError = std::max(maxError, calcAngle(vec3(unpackedFrame.a3, unpackedFrame.b3, unpackedFrame.c3), normal));
+		maxError = std::max(maxError, calcAngle(vec3(unpackedFrame.a1, unpackedFrame.b1, unpackedFrame.c1), tangent));
+	}
+
+	return maxError;
+}
+
+// Positions in a normalized format are stored relative to the bounding box of the mesh: the unpack matrix
+// scales and offsets them back (it is the identity for float positions)
+mat4 calcUnpackMatrix(const vector<vec3>& positions, DataType::Enum type)
+{
+	mat4 unpackMatrix;
+	if (!DataType::isNormalised(type) || positions.empty()) return unpackMatrix;
+
+	vec3 minCorner = positions[0];
+	vec3 maxCorner = positions[0];
+	for (uint i = 1; i < positions.size(); ++i)
+	{
+		for (uint k = 0; k < 3; ++k)
+		{
+			minCorner[k] = std::min(minCorner[k], positions[i][k]);
+			maxCorner[k] = std::max(maxCorner[k], positions[i][k]);
+		}
+	}
+
+	bool isSigned = (type == DataType::Int8Norm || type == DataType::Int16Norm);
+	for (uint k = 0; k < 3; ++k)
+	{
+		// signed formats cover [-1, 1] around the centre, unsigned ones [0, 1] from the minimum
+		float extent = maxCorner[k] - minCorner[k];
+		if (extent <= 0.0f) extent = 1.0f;
+		unpackMatrix[k][k] = isSigned ? extent * 0.5f : extent;
+		unpackMatrix[k][3] = isSigned ? (minCorner[k] + maxCorner[k]) * 0.5f : minCorner[k];
+	}
+
+	return unpackMatrix;
+}
+
+// UVs in a normalized format cover [0, 1]. Meshes whose UVs go beyond it (tiling) are remapped from the
+// smallest range of whole texture repeats containing them, so that identical UVs of different meshes
+// still get the same stored value within a repeat. The range is written with the mesh for the runtime.
+void calcUVUnpack(const vector<vec2>& texCoords, DataType::Enum type, vec2& offset, vec2& scale)
+{
+	offset = vec2(0.0f, 0.0f);
+	scale = vec2(1.0f, 1.0f);
+	if (!DataType::isNormalised(type) || texCoords.empty()) return;
+
+	vec2 minCorner = texCoords[0];
+	vec2 maxCorner = texCoords[0];
+	for (uint i = 1; i < texCoords.size(); ++i)
+	{
+		minCorner = vec2(std::min(minCorner.x, texCoords[i].x), std::min(minCorner.y, texCoords[i].y));
+		maxCorner = vec2(std::max(maxCorner.x, texCoords[i].x), std::max(maxCorner.y, texCoords[i].y));
+	}
+
+	offset = vec2(floorf(minCorner.x), floorf(minCorner.y));
+	scale = vec2(std::max(ceilf(maxCorner.x) - offset.x, 1.0f), std::max(ceilf(maxCorner.y) - offset.y, 1.0f));
+}
+
+// whether normalized UVs can be read back without the UV unpack
+bool isInUnitRange(const vector<vec2>& texCoords)
+{
+	for (uint i = 0; i < texCoords.size(); ++i)
+	{
+		if (texCoords[i].x < 0.0f || texCoords[i].x > 1.0f || texCoords[i].y < 0.0f || texCoords[i].y > 1.0f) return false;
+	}
+
+	return true;
+}
+
+// the transformation from the node to the world
+mat4 getWorldTransform(const aiNode* node)
+{
+	mat4 result = node->mTransformation;
+	for (node = node->mParent; node; node = node->mParent)
+	{
+		result = node->mTransformation * result;
+	}
+
+	return result;
+}
+
+// largest scale of the three axes of a transformation, a distance in its space is at most this much longer in world space
+float getMaxAxisScale(const mat4& m)
+{
+	float scaleX = sqrtf(m.a1 * m.a1 + m.b1 * m.b1 + m.c1 * m.c1);
+	float scaleY = sqrtf(m.a2 * m.a2 + m.b2 * m.b2 + m.c2 * m.c2);
+	float scaleZ = sqrtf(m.a3 * m.a3 + m.b3 * m.b3 + m.c3 * m.c3);
+	return std::max(scaleX, std::max(scaleY, scaleZ));
+}
+
+// largest distance between a position and the position read back from the interleaved data
+float calcMaxPositionError(const vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const vector<vec3>& positions, const mat4& unpackMatrix)
+{
+	float maxError = 0.0f;
+	for (uint i = 0; i < positions.size(); ++i)
+	{
+		PVRTVECTOR4f value;
+		PVRTVertexRead(&value, &vertexData[i * stride + attribute.offset], (EPVRTDataType)attribute.type, 3);
+		vec3 unpacked = unpackMatrix * vec3(value.x, value.y, value.z);
+		maxError = std::max(maxError, (unpacked - positions[i]).Length());
+	}
+
+	return maxError;
+}
+
+// largest difference, per component, between a UV and the UV read back from the interleaved data
+float calcMaxUVError(const vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const vector<vec2>& texCoords, const vec2& offset, const vec2& scale)
+{
+	float maxError = 0.0f;
+	for (uint i = 0; i < texCoords.size(); ++i)
+	{
+		PVRTVECTOR4f value;
+		PVRTVertexRead(&value, &vertexData[i * stride + attribute.offset], (EPVRTDataType)attribute.type, 2);
+		maxError = std::max(maxError, fabsf(offset.x + scale.x * value.x - texCoords[i].x));
+		maxError = std::max(maxError, fabsf(offset.y + scale.y * value.y - texCoords[i].y));
+	}
+
+	return maxError;
+}
+
+// Fills one attribute of every vertex of the interleaved data from the mesh, in the format of the attribute.
+// Returns the largest error the format introduces: a distance for positions, an angle in degrees for
+// directions, a difference in UV units for UVs (0 for the other attributes).
+float encodeMeshAttribute(vector<char>& vertexData, uint32 stride, const VertexAttribute& attribute, const MeshData& meshData,
+	const mat4& unpackMatrix, const vec2& uvOffset, const vec2& uvScale)
+{
+	switch (attribute.identifier)
+	{
+	case pod::e_meshVertexList:
+		if (attribute.type == DataType::Float32)
+		{
+			encodeVertexAttribute(vertexData, stride, attribute, meshData.positions.data(), DataType::Float32, sizeof(vec3));
+		}
+		else
+		{
+			// stored relative to the bounding box, the unpack matrix takes them back
+			mat4 packMatrix = unpackMatrix;
+			packMatrix.Inverse();
+			vector<vec3> packedPositions(meshData.positions.size());
+			for (uint v = 0; v < packedPositions.size(); ++v)
+			{
+				packedPositions[v] = packMatrix * meshData.positions[v];
+			}
+			encodeVertexAttribute(vertexData, stride, attribute, packedPositions.data(), DataType::Float32, sizeof(vec3));
+			return calcMaxPositionError(vertexData, stride, attribute, meshData.positions, unpackMatrix);
+		}
+		break;
+	case pod::e_meshNormalList:
+		if (attribute.numComponents == 4) return encodeQTangents(vertexData, stride, attribute, meshData);
+		return encodeDirections(vertexData, stride, attribute, meshData.normals);
+	case pod::e_meshTangentList:
+		if (attribute.numComponents == 4) return encodeTangentsWithSign(vertexData, stride, attribute, meshData);
+		return encodeDirections(vertexData, stride, attribute, meshData.tangents);
+	case pod::e_meshBinormalList:
+		return encodeDirections(vertexData, stride, attribute, meshData.bitangents);
+	case pod::e_meshUVWList:
+		if (attribute.type == DataType::Float32)
+		{
+			encodeVertexAttribute(vertexData, stride, attribute, meshData.texCoords.data(), DataType::Float32, sizeof(vec2));
+		}
+		else
+		{
+			vector<vec2> packedTexCoords(meshData.texCoords.size());
+			for (uint v = 0; v < packedTexCoords.size(); ++v)
+			{
+				packedTexCoords[v] = vec2((meshData.texCoords[v].x - uvOffset.x) / uvScale.x, (meshData.texCoords[v].y - uvOffset.y) / uvScale.y);
+			}
+			encodeVertexAttribute(vertexData, stride, attribute, packedTexCoords.data(), DataType::Float32, sizeof(vec2));
+			return calcMaxUVError(vertexData, stride, attribute, meshData.texCoords, uvOffset, uvScale);
+		}
+		break;
+	case pod::e_meshVertexColorList:
+		encodeVertexAttribute(vertexData, stride, attribute, meshData.colors.data(), DataType::Float32, sizeof(color4D));
+		break;
+	case pod::e_meshBoneIndexList:
+		// written by the bone batching, which turns them into indices into the bones of the batch
+		break;
+	case pod::e_meshBoneWeightList:
+		encodeBoneWeights(vertexData, stride, attribute, meshData.bones);
+		break;
+	}
+
+	return 0.0f;
+}
+
+bool hasTexture(const MaterialData& material, aiTextureType type)
+{
+	auto it = material.textureData.texturesMap.find(type);
+	return it != material.textureData.texturesMap.end() && !it->second.empty();
+}
+
+// the format the vertex data is loaded in
+DataType::Enum getLoadedFormat(uint32 listIdentifier)
+{
+	return listIdentifier == pod::e_meshBoneIndexList ? DataType::UInt16 : DataType::Float32;
+}
+
+// size of the values the attribute holds, in the format they are loaded in
+uint32 getLoadedSize(uint32 listIdentifier, uint32 numComponents)
+{
+	// the compacted tangent frames stand for several directions
+	if (listIdentifier == pod::e_meshNormalList && numComponents == 4) return 3 * sizeof(vec3);
+	if (listIdentifier == pod::e_meshTangentList && numComponents == 4) return 2 * sizeof(vec3);
+	return getVertexAttributeSize(getLoadedFormat(listIdentifier), numComponents);
+}
+
+const char* getAttributeName(uint32 listIdentifier, uint32 numComponents)
+{
+	switch (listIdentifier)
+	{
+	case pod::e_meshVertexList: return "position";
+	case pod::e_meshNormalList: return numComponents == 4 ? "qtangent" : "normal";
+	case pod::e_meshTangentList: return numComponents == 4 ? "tangentWithSign" : "tangent";
+	case pod::e_meshBinormalList: return "bitangent";
+	case pod::e_meshUVWList: return "uv";
+	case pod::e_meshVertexColorList: return "colour";
+	case pod::e_meshBoneIndexList: return "boneIndex";
+	case pod::e_meshBoneWeightList: return "boneWeight";
+	default: return "unknown";
+	}
+}
+
+const char* getDataTypeName(DataType::Enum type)
+{
+	switch (type)
+	{
+	case DataType::Float32: return "Float32";
+	case DataType::UInt16: return "UInt16";
+	case DataType::RGBA: return "RGBA";
+	case DataType::DEC3N: return "DEC3N";
+	case DataType::UInt8: return "UInt8";
+	case DataType::Int16Norm: return "Int16Norm";
+	case DataType::Int8Norm: return "Int8Norm";
+	case DataType::UInt8Norm: return "UInt8Norm";
+	case DataType::UInt16Norm: return "UInt16Norm";
+	default: return "Other";
+	}
+}
+
+}
+
+namespace pvr {
+namespace assets {
+namespace assetWriters {
+
+
+PODWriter::PODWriter(ModelLoader& loader)
+	: m_modelLoader(loader)
+	, m_Nodes(loader.getNodeList())
+	, m_numThreads(0)
+	, m_outputMode(StreamOutput)
+	, m_optimizeVertexCache(false)
+	, m_optimizeVertexFetch(false)
+	, m_force32BitIndices(false)
+	, m_splitLargeMeshes(false)
+	, m_vertexLayout(getDefaultVertexLayout())
+	, m_vertexStreamMode(InterleavedStream)
+	, m_tangentFrameMode(SeparateTangentFrame)
+	, m_pruneUnusedAttributes(false)
+	, m_autoQuantize(false)
+	, m_remapUVs(false)
+	, m_maxPositionError(0.001f)
+	, m_maxDirectionError(0.5f)
+	, m_maxUVError(0.25f)
+	, m_uvTextureSize(2048)
+{
+}
+
+PODWriter::VertexLayout PODWriter::getDefaultVertexLayout()
+{
+	static const uint32 identifiers[] = { pod::e_meshVertexList, pod::e_meshNormalList, pod::e_meshTangentList, pod::e_meshBinormalList,
+		pod::e_meshUVWList, pod::e_meshVertexColorList, pod::e_meshBoneIndexList, pod::e_meshBoneWeightList };
+
+	VertexLayout layout;
+	for (uint i = 0; i < ARRAY_SIZE_IN_ELEMENTS(identifiers); ++i)
+	{
+		VertexLayout::Attribute attribute = { identifiers[i], DataType::None };
+		layout.attributes.push_back(attribute);
+	}
+	layout.strideAlignment = 1;
+	return layout;
+}
+
+bool PODWriter::setVertexLayout(const VertexLayout& layout)
+{
+	VertexLayout defaultLayout = getDefaultVertexLayout();
+	vector<bool> used(defaultLayout.attributes.size(), false);
+	for (uint i = 0; i < layout.attributes.size(); ++i)
+	{
+		uint j = 0;
+		while (j < defaultLayout.attributes.size() && defaultLayout.attributes[j].identifier != layout.attributes[i].identifier) ++j;
+		if (j == defaultLayout.attributes.size())
+		{
+			cout << "\nVertex layout: " << layout.attributes[i].identifier << " is not a vertex attribute list" << endl;
+			return false;
+		}
+		if (used[j])
+		{
+			cout << "\nVertex layout: attribute " << layout.attributes[i].identifier << " is given twice" << endl;
+			return false;
+		}
+		used[j] = true;
+	}
+	if (!used[0])
+	{
+		cout << "\nVertex layout: the position is missing" << endl;
+		return false;
+	}
+	if (layout.strideAlignment == 0 || (layout.strideAlignment & (layout.strideAlignment - 1)) != 0)
+	{
+		cout << "\nVertex layout: the stride alignment " << layout.strideAlignment << " is not a power of two" << endl;
+		return false;
+	}
+
+	m_vertexLayout = layout;
+	for (uint j = 0; j < defaultLayout.attributes.size(); ++j)
+	{
+		bool isBoneList = defaultLayout.attributes[j].identifier == pod::e_meshBoneIndexList || defaultLayout.attributes[j].identifier == pod::e_meshBoneWeightList;
+		if (isBoneList && !used[j]) m_vertexLayout.attributes.push_back(defaultLayout.attributes[j]);
+	}
+	return true;
+}
+
+void PODWriter::exportModel(const std::string& path, ExportOptions options)
+{
+	// determine exporting options
+	m_exportSkinningData = (options == ExportEverything) || (options == ExportSkinningData);
+	m_exportAnimations = m_modelLoader.getScene()->HasAnimations() && (options == ExportEverything || options == ExportAnimation) ;
+	
+	// validate if there is skinning data
+	if (m_exportSkinningData)
+	{
+		for (uint i = 0; i < m_modelLoader.getScene()->mNumMeshes; ++i)
+		{
+			aiMesh* mesh = m_modelLoader.getScene()->mMeshes[i];
+			m_exportSkinningData = m_exportSkinningData && m_modelLoader.getScene()->mMeshes[i]->HasBones();
+		}
+	}
+
+	if (m_outputMode == StreamOutput)
+	{
+		m_fileStream = fstream(path, ios::binary | ios::out | ios::trunc);
+		if (!m_fileStream.is_open())
+		{
+			cout << "\nCannot open file: " << path;
+			return;
+		}
+	}
+	else if (m_outputMode == AsyncOutput)
+	{
+		m_asyncWriter.reset(new AsyncFileWriter());
+		if (!m_asyncWriter->open(path))
+		{
+			cout << "\nCannot open file: " << path;
+			m_asyncWriter.reset();
+			return;
+		}
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	m_numBytesWritten = 0;
+	m_buffer.clear();
+	m_buffer.reserve(FLUSH_THRESHOLD_IN_BYTES);
+	m_workerPool.reset(new WorkerPool(m_numThreads));
+
+	// write pod version block
+	writeStartTag(m_buffer, pod::PODFormatVersion, pod::c_PODFormatVersionLength);
+	writeByteArray(m_buffer, pod::c_PODFormatVersion, pod::c_PODFormatVersionLength);
+	writeEndTag(m_buffer, pod::PODFormatVersion);
+
+	// write history block
+	std::string msg = HISTORY_MESSAGE;
+	writeStartTag(m_buffer, pod::FileHistory, msg.length() + 1);
+	writeByteArrayFromeString(m_buffer, msg);
+	writeEndTag(m_buffer, pod::FileHistory);
+
+	// write scene block
+	// a block that contains only further nested blocks between its Start and End tags 
+	// will have a Length of zero. 
+	writeStartTag(m_buffer, pod::Scene, 0);
+	writeSceneBlock();
+	writeEndTag(m_buffer, pod::Scene);
+
+	flushBuffer(true);
+
+	if (m_outputMode == AsyncOutput)
+	{
+		double serializationSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		m_asyncWriter->close();
+		m_numBytesWritten = m_asyncWriter->getNumBytesWritten();
+
+		cout << "\nSerialization: " << (serializationSeconds - m_asyncWriter->getStallSeconds()) * 1000.0 << " ms computing, "
+			<< m_asyncWriter->getStallSeconds() * 1000.0 << " ms stalled on I/O. I/O thread: "
+			<< m_asyncWriter->getWriteSeconds() * 1000.0 << " ms writing." << endl;
+		m_asyncWriter.reset();
+	}
+	else
+	{
+		m_fileStream.flush();
+		m_fileStream.close();
+	}
+	m_workerPool.reset();
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	cout << "\nWrote " << m_numBytesWritten << " bytes in " << seconds * 1000.0 << " ms ("
+		<< (seconds > 0.0 ? m_numBytesWritten / (1024.0 * 1024.0) / seconds : 0.0) << " MB/s)." << endl;
+}
+
+void PODWriter::flushBuffer(bool force)
+{
+	if (force || m_buffer.size() >= FLUSH_THRESHOLD_IN_BYTES)
+	{
+		emitBuffer(m_buffer);
+	}
+}
+
+void PODWriter::emitBuffer(PODBlockBuffer& buffer)
+{
+	if (buffer.empty()) return;
+
+	if (m_outputMode == AsyncOutput)
+	{
+		m_asyncWriter->submit(buffer);
+	}
+	else
+	{
+		m_numBytesWritten += buffer.flushTo(m_fileStream);
+	}
+}
+
+void PODWriter::writeBlocksInParallel(uint numBlocks, BlockWriterFunc blockWriter)
+{
+	// serialize a window of blocks at a time, each one into its own buffer, then join them
+	// in the original order so the file stays deterministic no matter how many threads are used
+	uint windowSize = m_workerPool->getNumThreads() * 2;
+	vector<PODBlockBuffer> blocks(windowSize);
+
+	for (uint first = 0; first < numBlocks; first += windowSize)
+	{
+		uint count = std::min(windowSize, numBlocks - first);
+
+		m_workerPool->parallelFor(count, [&](uint i)
+		{
+			blocks[i].clear();
+			(this->*blockWriter)(first + i, blocks[i]);
+		});
+
+		for (uint i = 0; i < count; ++i)
+		{
+			writeBlock(blocks[i]);
+		}
+	}
+}
+
+void PODWriter::writeBlock(PODBlockBuffer& block)
+{
+	// keep the order: anything pending in the main buffer goes first
+	flushBuffer(true);
+	emitBuffer(block);
+}
+
+void PODWriter::writeStartTag(PODBlockBuffer& out, uint32 identifier, uint32 dataLength)
+{
+	writeTag(out, pod::c_startTagMask, identifier, dataLength);
+}
+
+void PODWriter::writeEndTag(PODBlockBuffer& out, uint32 identifier)
+{
+	writeTag(out, pod::c_endTagMask, identifier, 0);
+}
+
+void PODWriter::optimizeIndexBuffer(uint meshIndex, vector<uint32>& indices, uint numVertices, const int* batchOffsets, int numBatches)
+{
+	if (!m_optimizeVertexCache) return;
+
+	MeshExportStats& stats = m_meshStats[meshIndex];
+	stats.acmrBefore = VertexCacheOptimizer::calcACMR(indices.data(), indices.size(), numVertices);
+
+	if (numBatches > 0)
+	{
+		// each bone batch is drawn on its own, so the triangles can only move inside their batch
+		for (int i = 0; i < numBatches; ++i)
+		{
+			uint first = batchOffsets[i] * 3;
+			uint last = (i + 1 < numBatches) ? batchOffsets[i + 1] * 3 : indices.size();
+			VertexCacheOptimizer::optimize(indices.data() + first, last - first, numVertices);
+		}
+	}
+	else
+	{
+		VertexCacheOptimizer::optimize(indices.data(), indices.size(), numVertices);
+	}
+
+	stats.acmrAfter = VertexCacheOptimizer::calcACMR(indices.data(), indices.size(), numVertices);
+}
+
+uint PODWriter::optimizeVertexOrder(vector<uint32>& indices, uint numVertices, vector<uint32>& remap)
+{
+	if (!m_optimizeVertexFetch)
+	{
+		remap.resize(numVertices);
+		for (uint i = 0; i < numVertices; ++i)
+			remap[i] = i;
+		return numVertices;
+	}
+
+	return VertexCacheOptimizer::optimizeVertexFetch(indices.data(), indices.size(), numVertices, remap);
+}
+
+void PODWriter::buildExportLists()
+{
+	uint numModels = m_modelDataVec.size();
+	uint maxBonesPerBatch = m_exportSkinningData ? MAX_NUM_BONES_PER_BATCH : 0;
+
+	vector<vector<MeshData>> parts(numModels);
+	if (m_splitLargeMeshes)
+	{
+		m_workerPool->parallelFor(numModels, [&](uint i)
+		{
+			// the bone batching duplicates vertices, so skinned meshes are checked whatever their size
+			const MeshData& meshData = m_modelDataVec[i]->meshData;
+			if (maxBonesPerBatch > 0 || meshData.numVertices > MAX_NUM_VERTICES_16BIT_INDICES)
+			{
+				parts[i] = MeshSplitter::split(meshData, MAX_NUM_VERTICES_16BIT_INDICES, maxBonesPerBatch);
+			}
+		});
+	}
+
+	m_exportMeshes.clear();
+	m_exportNodeSources.clear();
+	m_exportNodeIndices.assign(m_Nodes.size(), -1);
+
+	// the first nodes of the list are the mesh nodes, node i being the node of mesh i
+	for (uint i = 0; i < numModels; ++i)
+	{
+		m_exportNodeIndices[i] = m_exportMeshes.size();
+
+		// the optional streams the material can make use of
+		const MaterialData& material = m_modelDataVec[i]->materialData;
+		const vector<color4D>& colors = m_modelDataVec[i]->meshData.colors;
+		ExportMesh mesh;
+		mesh.modelIndex = i;
+		mesh.part = -1;
+		mesh.useTexCoords = false;
+		for (auto it = material.textureData.texturesMap.begin(); it != material.textureData.texturesMap.end(); ++it)
+		{
+			mesh.useTexCoords = mesh.useTexCoords || !it->second.empty();
+		}
+		mesh.useTangentFrame = hasTexture(material, aiTextureType_NORMALS) || hasTexture(material, aiTextureType_HEIGHT);
+		mesh.useColors = false;
+		for (uint v = 1; v < colors.size() && !mesh.useColors; ++v)
+		{
+			mesh.useColors = colors[v] != colors[0];
+		}
+
+		if (parts[i].empty())
+		{
+			mesh.meshData = MeshDataPtr(m_modelDataVec[i], &m_modelDataVec[i]->meshData);
+			m_exportMeshes.push_back(mesh);
+			m_exportNodeSources.push_back(i);
+			continue;
+		}
+
+		cout << "\nSplit " << m_modelDataVec[i]->meshData.name << " (" << m_modelDataVec[i]->meshData.numVertices << " vertices) into " << parts[i].size() << " meshes." << endl;
+		for (uint p = 0; p < parts[i].size(); ++p)
+		{
+			mesh.meshData = MeshDataPtr(new MeshData(std::move(parts[i][p])));
+			mesh.part = p;
+			m_exportMeshes.push_back(mesh);
+			m_exportNodeSources.push_back(i);
+		}
+	}
+
+	for (uint i = numModels; i < m_Nodes.size(); ++i)
+	{
+		m_exportNodeIndices[i] = m_exportNodeSources.size();
+		m_exportNodeSources.push_back(i);
+	}
+}
+
+DataType::Enum PODWriter::getAttributeFormat(uint32 listIdentifier) const
+{
+	auto it = m_attributeFormats.find(listIdentifier);
+	if (it != m_attributeFormats.end()) return it->second;
+
+	return getLoadedFormat(listIdentifier);
+}
+
+DataType::Enum PODWriter::selectAttributeFormat(const MeshData& meshData, uint32 listIdentifier, uint32 numComponents, float positionScale, DataType::Enum layoutFormat) const
+{
+	// normalized UVs outside [0, 1] would need the UV unpack, which POD loaders do not know about
+	bool needsUVUnpack = listIdentifier == pod::e_meshUVWList && !m_remapUVs && !isInUnitRange(meshData.texCoords);
 
-	// write stride: The distance, in bytes, from one array member to the next. 
-	writeTag(stream, pod::c_startTagMask, pod::e_blockStride, 4);
-	write4Bytes(stream, stride);
-	writeTag(stream, pod::c_endTagMask, pod::e_blockStride, 0);
+	// a format set in the vertex layout is used as it is
+	if (!m_autoQuantize || layoutFormat != DataType::None)
+	{
+		// the packed formats have no room for a fourth component, the compacted tangent frames use bytes instead
+		DataType::Enum format = layoutFormat != DataType::None ? layoutFormat : getAttributeFormat(listIdentifier);
+		if (needsUVUnpack && DataType::isNormalised(format)) return DataType::Float32;
+		if (DataType::componentCount(format) > 1 && DataType::componentCount(format) < numComponents) return DataType::Int8Norm;
+		return format;
+	}
 
-	// write the block data buffer
-	writeTag(stream, pod::c_startTagMask, pod::e_blockData, data.size() * sizeof(T));
+	// the candidates, smallest first
+	static const DataType::Enum positionFormats[] = { DataType::UInt16Norm };
+	static const DataType::Enum directionFormats[] = { DataType::Int8Norm, DataType::DEC3N, DataType::Int16Norm };
+	static const DataType::Enum uvFormats[] = { DataType::UInt8Norm, DataType::UInt16Norm };
 
-	switch (DataType::size(type))
+	const DataType::Enum* formats;
+	uint numFormats;
+	float maxError;
+	switch (listIdentifier)
 	{
-	case 1:
-		writeByteArrayFromVector<T>(stream, data);
+	case pod::e_meshVertexList:
+		formats = positionFormats; numFormats = ARRAY_SIZE_IN_ELEMENTS(positionFormats);
+		// the error is measured on the mesh, before the node scales it into the world
+		maxError = positionScale > 0.0f ? m_maxPositionError / positionScale : m_maxPositionError;
 		break;
-	case 2:
-		write2ByteArrayFromVector<T>(stream, data);
+	case pod::e_meshNormalList:
+	case pod::e_meshTangentList:
+	case pod::e_meshBinormalList:
+		formats = directionFormats; numFormats = ARRAY_SIZE_IN_ELEMENTS(directionFormats);
+		maxError = m_maxDirectionError;
 		break;
-	case 4:
-		write4ByteArrayFromVector<T>(stream, data);
+	case pod::e_meshUVWList:
+		formats = uvFormats; numFormats = ARRAY_SIZE_IN_ELEMENTS(uvFormats);
+		maxError = m_maxUVError / m_uvTextureSize;
 		break;
+	default:
+		return getAttributeFormat(listIdentifier);
 	}
 
-	writeTag(stream, pod::c_endTagMask, pod::e_blockData, 0);
-}
-
-void writeVertexAttributeOffset(fstream& stream, pvr::DataType::Enum type, uint32 numComponents, uint32 stride, uint32 offset)
-{
-	// write block data type
-	writeTag(stream, pod::c_startTagMask, pod::e_blockDataType, 4);
-	write4Bytes(stream, type);
-	writeTag(stream, pod::c_endTagMask, pod::e_blockDataType, 0);
+	// encode the attribute on its own in each candidate format until one is precise enough
+	for (uint i = 0; i < numFormats; ++i)
+	{
+		if (DataType::componentCount(formats[i]) > 1 && DataType::componentCount(formats[i]) < numComponents) continue;
+		if (needsUVUnpack && DataType::isNormalised(formats[i])) continue;
 
-	// write num components (e.g. position buffer, it has x, y, z, so numComponents = 3)
-	writeTag(stream, pod::c_startTagMask, pod::e_blockNumComponents, 4);
-	write4Bytes(stream, numComponents);
-	writeTag(stream, pod::c_endTagMask, pod::e_blockNumComponents, 0);
+		VertexAttribute attribute = { listIdentifier, formats[i], numComponents, 0 };
+		uint32 size = getVertexAttributeSize(attribute.type, numComponents);
+		vector<char> vertexData(size * meshData.numVertices);
 
-	// write stride: The distance, in bytes, from one array member to the next. 
-	writeTag(stream, pod::c_startTagMask, pod::e_blockStride, 4);
-	write4Bytes(stream, stride);
-	writeTag(stream, pod::c_endTagMask, pod::e_blockStride, 0);
+		vec2 uvOffset, uvScale;
+		calcUVUnpack(meshData.texCoords, attribute.type, uvOffset, uvScale);
+		float error = encodeMeshAttribute(vertexData, size, attribute, meshData, calcUnpackMatrix(meshData.positions, attribute.type), uvOffset, uvScale);
+		if (error <= maxError) return attribute.type;
+	}
 
-	// write the block data buffer (here, we write the offset of this vertex attribute)
-	writeTag(stream, pod::c_startTagMask, pod::e_blockData, 4);
-	write4Bytes(stream, offset);
-	writeTag(stream, pod::c_endTagMask, pod::e_blockData, 0);
+	return DataType::Float32;
 }
 
-template <typename T>
-void addByteIntoVector(T& data, vector<char>& targetVector)
+int32 PODWriter::findExportNodeIndex(const aiNode* node) const
 {
-	char *temp;
-	temp = reinterpret_cast<char*>(&data);
-	for (uint i = 0; i < sizeof(T); ++i)
-		targetVector.push_back(temp[i]);
-}
+	for (uint i = 0; i < m_Nodes.size(); ++i)
+	{
+		if (m_Nodes[i] == node)
+		{
+			return m_exportNodeIndices[i];
+		}
+	}
 
+	return -1;
 }
 
-namespace pvr {
-namespace assets {
-namespace assetWriters {
+std::string PODWriter::getExportNodeName(uint index) const
+{
+	std::string name(m_Nodes[m_exportNodeSources[index]]->mName.C_Str());
 
+	// the nodes of the parts of a split mesh are told apart by a suffix
+	if (index < m_exportMeshes.size() && m_exportMeshes[index].part >= 0)
+	{
+		name += "-part" + std::to_string(m_exportMeshes[index].part);
+	}
 
-PODWriter::PODWriter(ModelLoader& loader)
-	: m_modelLoader(loader)
-	, m_Nodes(loader.getNodeList())
-{
+	return name;
 }
 
-void PODWriter::exportModel(const std::string& path, ExportOptions options)
+void PODWriter::resampleNodeAnimations(uint numNodes)
 {
-	// determine exporting options
-	m_exportSkinningData = (options == ExportEverything) || (options == ExportSkinningData);
-	m_exportAnimations = m_modelLoader.getScene()->HasAnimations() && (options == ExportEverything || options == ExportAnimation) ;
-	
-	// validate if there is skinning data
-	if (m_exportSkinningData)
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	aiAnimation* animation = m_modelLoader.getScene()->mAnimations[0];
+	uint numFrames = m_animationHelper.getNumFrames();
+	float frameInterval = (float)m_animationHelper.getFrameIntervalInTicks();
+
+	// The frames of the animated nodes, cut into ranges so that a few long channels still keep every thread
+	// busy. Every frame is sampled on its own, the result does not depend on the number of threads.
+	struct FrameRange
 	{
-		for (uint i = 0; i < m_modelLoader.getScene()->mNumMeshes; ++i)
+		uint node;
+		aiNodeAnim* channel;
+		uint first;
+		uint last;
+	};
+	const uint framesPerRange = 256;
+	vector<FrameRange> ranges;
+	m_nodeAnimations.assign(numNodes, vector<mat4>());
+	for (uint i = 0; i < numNodes; ++i)
+	{
+		aiNodeAnim* channel = m_animationHelper.findNodeAnim(animation, m_Nodes[m_exportNodeSources[i]]->mName);
+		if (!channel) continue;
+
+		m_nodeAnimations[i].resize(numFrames);
+		for (uint first = 0; first < numFrames; first += framesPerRange)
 		{
-			aiMesh* mesh = m_modelLoader.getScene()->mMeshes[i];
-			m_exportSkinningData = m_exportSkinningData && m_modelLoader.getScene()->mMeshes[i]->HasBones();
+			FrameRange range = { i, channel, first, std::min(first + framesPerRange, numFrames) };
+			ranges.push_back(range);
 		}
 	}
 
-	m_fileStream = fstream(path, ios::binary | ios::out | ios::trunc);
-
-	if (m_fileStream.is_open())
+	m_workerPool->parallelFor((uint)ranges.size(), [&](uint r)
 	{
-		// write pod version block
-		writeStartTag(pod::PODFormatVersion, pod::c_PODFormatVersionLength);
-		writeByteArray(m_fileStream, pod::c_PODFormatVersion, pod::c_PODFormatVersionLength);
-		writeEndTag(pod::PODFormatVersion);
+		const FrameRange& range = ranges[r];
+		vector<mat4>& frames = m_nodeAnimations[range.node];
+		AnimationHelper::KeyCursor cursor;
+		for (uint i = range.first; i < range.last; ++i)
+		{
+			vec3 pos, scaling;
+			quat rot;
 
-		// write history block
-		std::string msg = HISTORY_MESSAGE;
-		writeStartTag(pod::FileHistory, msg.length() + 1);
-		writeByteArrayFromeString(m_fileStream, msg);
-		writeEndTag(pod::FileHistory);
+			float frameTime = i * frameInterval;
+			m_animationHelper.calcInterpolatedPosition(pos, frameTime, range.channel, &cursor);
+			m_animationHelper.calcInterpolatedRotation(rot, frameTime, range.channel, &cursor);
+			m_animationHelper.calcInterpolatedScaling(scaling, frameTime, range.channel, &cursor);
 
-		// write scene block
-		// a block that contains only further nested blocks between its Start and End tags 
-		// will have a Length of zero. 
-		writeStartTag(pod::Scene, 0);
-		writeSceneBlock();
-		writeEndTag(pod::Scene);
+			frames[i] = mat4(scaling, rot, pos);
+		}
+	});
 
-		m_fileStream.flush();
-		m_fileStream.close();
-	}
-	else
+	uint numAnimatedNodes = 0;
+	for (uint i = 0; i < numNodes; ++i)
 	{
-		cout << "\nCannot open file: " << path;
+		if (!m_nodeAnimations[i].empty()) ++numAnimatedNodes;
 	}
-
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	cout << "\nResampled " << numAnimatedNodes << " animated nodes x " << numFrames << " frames in " << seconds * 1000.0 << " ms." << endl;
 }
 
-void PODWriter::writeStartTag(uint32 identifier, uint32 dataLength)
+bool PODWriter::writeQuantizationReport()
 {
-	writeTag(m_fileStream, pod::c_startTagMask, identifier, dataLength);
-}
+	ofstream report(m_quantizationReportPath.c_str(), ios::out | ios::trunc);
+	if (!report.is_open())
+	{
+		cout << "\nCannot open file: " << m_quantizationReportPath << endl;
+		return false;
+	}
 
-void PODWriter::writeEndTag(uint32 identifier)
-{
-	writeTag(m_fileStream, pod::c_endTagMask, identifier, 0);
+	// one line per attribute of every mesh. The error is in world units for positions, in degrees for
+	// directions and in texels of a texture of the configured size for UVs, the bytes saved are counted
+	// against the format the attribute is loaded in.
+	report << "mesh,attribute,format,max_error,error_unit,bytes_per_vertex,num_vertices,bytes_saved\n";
+	size_t totalBytesSaved = 0;
+	for (uint i = 0; i < m_meshStats.size(); ++i)
+	{
+		const MeshExportStats& stats = m_meshStats[i];
+		std::string name = m_exportMeshes[i].meshData->name;
+		for (size_t quote = name.find('"'); quote != std::string::npos; quote = name.find('"', quote + 2))
+		{
+			name.insert(quote, 1, '"');
+		}
+
+		for (uint j = 0; j < stats.attributes.size(); ++j)
+		{
+			const MeshExportStats::Attribute& attribute = stats.attributes[j];
+			uint32 size = getVertexAttributeSize(attribute.format, attribute.numComponents);
+			uint32 loadedSize = getLoadedSize(attribute.identifier, attribute.numComponents);
+			size_t bytesSaved = loadedSize > size ? (size_t)(loadedSize - size) * stats.numVertices : 0;
+			totalBytesSaved += bytesSaved;
+
+			const char* unit = "";
+			float error = attribute.error;
+			switch (attribute.identifier)
+			{
+			case pod::e_meshVertexList: unit = "world"; break;
+			case pod::e_meshNormalList:
+			case pod::e_meshTangentList:
+			case pod::e_meshBinormalList: unit = "degrees"; break;
+			case pod::e_meshUVWList: unit = "texels"; error *= m_uvTextureSize; break;
+			}
+
+			report << '"' << name << "\"," << getAttributeName(attribute.identifier, attribute.numComponents) << "," << getDataTypeName(attribute.format) << ","
+				<< error << "," << unit << "," << size << "," << stats.numVertices << "," << bytesSaved << "\n";
+		}
+	}
+
+	cout << "\nQuantization report written to " << m_quantizationReportPath << " (" << totalBytesSaved << " bytes saved)." << endl;
+	return true;
 }
 
 void PODWriter::writeSceneBlock()
 {
 	const aiScene* scene = m_modelLoader.getScene();
 
+	buildExportLists();
+
 	// Clear Color
 	float clearColor[3] = {0.68f, 0.68f, 0.68f};
-	writeStartTag(pod::e_sceneClearColor, 3 * 4);
-	write4ByteArray(m_fileStream, clearColor, 3);
-	writeEndTag(pod::e_sceneClearColor);
+	writeStartTag(m_buffer, pod::e_sceneClearColor, 3 * 4);
+	write4ByteArray(m_buffer, clearColor, 3);
+	writeEndTag(m_buffer, pod::e_sceneClearColor);
 
 	// Ambient Color
- 	writeStartTag(pod::e_sceneAmbientColor, 3 * 4);
- 	write4ByteArray(m_fileStream, &m_modelLoader.getSceneAmbientColor()[0], 3);
- 	writeEndTag(pod::e_sceneAmbientColor);
+ 	writeStartTag(m_buffer, pod::e_sceneAmbientColor, 3 * 4);
+ 	write4ByteArray(m_buffer, &m_modelLoader.getSceneAmbientColor()[0], 3);
+ 	writeEndTag(m_buffer, pod::e_sceneAmbientColor);
 
 	// Num. Cameras
   	uint32 numCameras = scene->mNumCameras;
-  	writeStartTag(pod::e_sceneNumCameras, 4);
-  	write4Bytes(m_fileStream, numCameras);
-  	writeEndTag(pod::e_sceneNumCameras);
+  	writeStartTag(m_buffer, pod::e_sceneNumCameras, 4);
+  	write4Bytes(m_buffer, numCameras);
+  	writeEndTag(m_buffer, pod::e_sceneNumCameras);
   
   	// Camera Block
   	for (uint i = 0; i < numCameras; ++i)
   	{
-  		writeCameraBlock(i);
+  		writeCameraBlock(i, m_buffer);
+  		flushBuffer();
   	}
     cout << "\nExported Cameras." << endl;
 
@@ -309,46 +1316,47 @@ void PODWriter::writeSceneBlock()
 			++numLights;
 		}
 	}
-	writeStartTag(pod::e_sceneNumLights, 4);
-	write4Bytes(m_fileStream, numLights);
-	writeEndTag(pod::e_sceneNumLights);
+	writeStartTag(m_buffer, pod::e_sceneNumLights, 4);
+	write4Bytes(m_buffer, numLights);
+	writeEndTag(m_buffer, pod::e_sceneNumLights);
 
 	// Light Block
 	for (uint i = 0; i < numLights; ++i)
 	{
-		writeLightBlock(i);
+		writeLightBlock(i, m_buffer);
+		flushBuffer();
 	}
  	cout << "\nExported Lights." << endl;
 
 	// Num. Meshes
-	uint32 numMeshes = m_modelDataVec.size();
-	writeStartTag(pod::e_sceneNumMeshes, 4);
-	write4Bytes(m_fileStream, numMeshes);
-	writeEndTag(pod::e_sceneNumMeshes);
+	uint32 numMeshes = m_exportMeshes.size();
+	writeStartTag(m_buffer, pod::e_sceneNumMeshes, 4);
+	write4Bytes(m_buffer, numMeshes);
+	writeEndTag(m_buffer, pod::e_sceneNumMeshes);
 
 	// Num. Nodes
-	uint32 numNodes = m_Nodes.size();
-	writeStartTag(pod::e_sceneNumNodes, 4);
-	write4Bytes(m_fileStream, numNodes);
-	writeEndTag(pod::e_sceneNumNodes);
+	uint32 numNodes = m_exportNodeSources.size();
+	writeStartTag(m_buffer, pod::e_sceneNumNodes, 4);
+	write4Bytes(m_buffer, numNodes);
+	writeEndTag(m_buffer, pod::e_sceneNumNodes);
 
 	// Num. Mesh Nodes
-	uint32 numMeshNodes = m_modelDataVec.size();
-	writeStartTag(pod::e_sceneNumMeshNodes, 4);
-	write4Bytes(m_fileStream, numMeshNodes);
-	writeEndTag(pod::e_sceneNumMeshNodes);
+	uint32 numMeshNodes = m_exportMeshes.size();
+	writeStartTag(m_buffer, pod::e_sceneNumMeshNodes, 4);
+	write4Bytes(m_buffer, numMeshNodes);
+	writeEndTag(m_buffer, pod::e_sceneNumMeshNodes);
 
 	// Num. Textures
 	uint32 numTextures = m_modelLoader.getNumTextures();
-	writeStartTag(pod::e_sceneNumTextures, 4);
-	write4Bytes(m_fileStream, numTextures);
-	writeEndTag(pod::e_sceneNumTextures);
+	writeStartTag(m_buffer, pod::e_sceneNumTextures, 4);
+	write4Bytes(m_buffer, numTextures);
+	writeEndTag(m_buffer, pod::e_sceneNumTextures);
 
 	// Num. Materials (1 mesh 1 material)
 	uint32 numMaterials = m_modelDataVec.size();
-	writeStartTag(pod::e_sceneNumMaterials, 4);
-	write4Bytes(m_fileStream, numMaterials);
-	writeEndTag(pod::e_sceneNumMaterials);
+	writeStartTag(m_buffer, pod::e_sceneNumMaterials, 4);
+	write4Bytes(m_buffer, numMaterials);
+	writeEndTag(m_buffer, pod::e_sceneNumMaterials);
 
 	if (m_exportAnimations)
 	{
@@ -357,55 +1365,171 @@ void PODWriter::writeSceneBlock()
 		m_animationHelper.reSampleAnimation(animation);
 
 		// Num. Frames
-		writeStartTag(pod::e_sceneNumFrames, 4);
-		write4Bytes(m_fileStream, m_animationHelper.getNumFrames());
-		writeEndTag(pod::e_sceneNumFrames);
+		writeStartTag(m_buffer, pod::e_sceneNumFrames, 4);
+		write4Bytes(m_buffer, m_animationHelper.getNumFrames());
+		writeEndTag(m_buffer, pod::e_sceneNumFrames);
 
 		// FPS (30 fps by default)
 		uint32 fps = 30;
-		writeStartTag(pod::e_sceneFPS, 4);
-		write4Bytes(m_fileStream, fps);
-		writeEndTag(pod::e_sceneFPS);
+		writeStartTag(m_buffer, pod::e_sceneFPS, 4);
+		write4Bytes(m_buffer, fps);
+		writeEndTag(m_buffer, pod::e_sceneFPS);
 	}
 
 	// Material Block
-	for (uint i = 0; i < m_modelDataVec.size(); ++i)
-	{
-		writeMaterialBlock(i);
-	}
+	writeBlocksInParallel(m_modelDataVec.size(), &PODWriter::writeMaterialBlock);
 	cout << "\nExported Materials." << endl;
 
 	// Mesh Block
-	for (uint i = 0; i < m_modelDataVec.size(); ++i)
+	// each mesh block only depends on its own mesh data, so they are serialized on the worker pool
+	m_meshStats.assign(numMeshes, MeshExportStats());
+	writeBlocksInParallel(numMeshes, &PODWriter::writeMeshBlock);
+	for (uint32 i = 0; i < numMeshes; ++i)
+	{
+		const MeshExportStats& stats = m_meshStats[i];
+		cout << "\n" << i << " " << m_exportMeshes[i].meshData->name;
+		if (m_optimizeVertexCache)
+			cout << " ACMR: " << stats.acmrBefore << " -> " << stats.acmrAfter;
+		for (uint j = 0; j < stats.attributes.size(); ++j)
+		{
+			const MeshExportStats::Attribute& attribute = stats.attributes[j];
+			if (attribute.error > 0.0f)
+				cout << " " << getAttributeName(attribute.identifier, attribute.numComponents) << " " << getDataTypeName(attribute.format) << " max. error: " << attribute.error;
+		}
+		if (stats.prunedBytesPerVertex > 0)
+			cout << " Pruned: " << stats.prunedBytesPerVertex << " bytes per vertex";
+	}
+	cout << endl;
+	if (m_pruneUnusedAttributes)
+	{
+		size_t prunedBytes = 0;
+		for (uint32 i = 0; i < numMeshes; ++i)
+		{
+			prunedBytes += (size_t)m_meshStats[i].prunedBytesPerVertex * m_meshStats[i].numVertices;
+		}
+		cout << "\nPruned " << prunedBytes << " bytes of vertex attributes the materials do not use." << endl;
+	}
+	if (!m_quantizationReportPath.empty())
 	{
-		writeMeshBlock(i);
+		writeQuantizationReport();
 	}
 	cout << "\nExported Meshes." << endl;
 
 	// Node Block
 	cout << "\nExporting Nodes..." << endl;
+	if (m_exportAnimations)
+	{
+		resampleNodeAnimations(numNodes);
+	}
+	writeBlocksInParallel(numNodes, &PODWriter::writeNodeBlock);
 	for (uint32 i = 0; i < numNodes; ++i)
 	{
-		writeNodeBlock(i);
+		cout << "\n" << i << " " << getExportNodeName(i);
 	}
 	cout << "\n\nExported Nodes." << endl;
 
 	// Texture Block
 	for (uint32 i = 0; i < numTextures; ++i)
 	{
-		writeTextureBlock(i);
+		writeTextureBlock(i, m_buffer);
+		flushBuffer();
 	}
 	cout << "\nExported Textures..." << endl;
 
 	cout << "\n\nDone Exporting." << endl;
 }
 
-void PODWriter::writeMeshBlock(uint index)
+void PODWriter::writeMeshBlock(uint index, PODBlockBuffer& out)
 {
-	MeshData meshData = m_modelDataVec[index]->meshData;
+	const ExportMesh& exportMesh = m_exportMeshes[index];
+	const MeshData& meshData = *exportMesh.meshData;
+	MeshExportStats& stats = m_meshStats[index];
+
+	// the mesh nodes are written first, so the node of the mesh has the same index
+	float positionScale = getMaxAxisScale(getWorldTransform(m_Nodes[m_exportNodeSources[index]]));
 
 	// write mesh block
-	writeStartTag(pod::e_sceneMesh, 0);
+	writeStartTag(out, pod::e_sceneMesh, 0);
+
+	// Interleaved vertex layout
+	// The attributes of the vertex layout the mesh has, with the stride padded to the layout's alignment.
+	// When pruning, the streams the material cannot use are left out. Returns the stride.
+	auto buildLayout = [&](bool prune, vector<VertexAttribute>& attributes)
+	{
+		bool hasNormals = meshData.normals.size() > 0;
+		bool hasTangents = meshData.tangents.size() > 0 && (!prune || exportMesh.useTangentFrame);
+		bool hasBitangents = meshData.bitangents.size() > 0 && (!prune || exportMesh.useTangentFrame);
+		bool hasTexCoords = meshData.texCoords.size() > 0 && (!prune || exportMesh.useTexCoords);
+		bool hasColors = meshData.colors.size() > 0 && (!prune || exportMesh.useColors);
+
+		auto inLayout = [this](uint32 identifier)
+		{
+			for (uint i = 0; i < m_vertexLayout.attributes.size(); ++i)
+			{
+				if (m_vertexLayout.attributes[i].identifier == identifier) return true;
+			}
+			return false;
+		};
+
+		// the tangent frame is written as it is unless all of it is there, and the attribute holding the
+		// compacted frame is in the layout
+		TangentFrameMode tangentFrameMode = SeparateTangentFrame;
+		if (hasNormals && hasTangents && hasBitangents && inLayout(pod::e_meshNormalList) && (m_tangentFrameMode != TangentWithSign || inLayout(pod::e_meshTangentList)))
+		{
+			tangentFrameMode = m_tangentFrameMode;
+		}
+
+		uint32 stride = 0;
+		for (uint i = 0; i < m_vertexLayout.attributes.size(); ++i)
+		{
+			const VertexLayout::Attribute& layoutAttribute = m_vertexLayout.attributes[i];
+			uint32 numComponents;
+			switch (layoutAttribute.identifier)
+			{
+			case pod::e_meshVertexList:
+				numComponents = 3;
+				break;
+			case pod::e_meshNormalList:
+				if (!hasNormals) continue;
+				numComponents = tangentFrameMode == QTangent ? 4 : 3;
+				break;
+			case pod::e_meshTangentList:
+				if (!hasTangents || tangentFrameMode == QTangent) continue;
+				numComponents = tangentFrameMode == TangentWithSign ? 4 : 3;
+				break;
+			case pod::e_meshBinormalList:
+				if (!hasBitangents || tangentFrameMode != SeparateTangentFrame) continue;
+				numComponents = 3;
+				break;
+			case pod::e_meshUVWList:
+				if (!hasTexCoords) continue;
+				numComponents = 2;
+				break;
+			case pod::e_meshVertexColorList:
+				if (!hasColors) continue;
+				numComponents = 4;
+				break;
+			default:	// bone indices and weights
+				if (!m_exportSkinningData) continue;
+				numComponents = NUM_BONES_PER_VEREX;
+				break;
+			}
+			DataType::Enum format = selectAttributeFormat(meshData, layoutAttribute.identifier, numComponents, positionScale, layoutAttribute.format);
+			stride = addVertexAttribute(attributes, layoutAttribute.identifier, format, numComponents, stride);
+		}
+
+		// the padding is left zeroed
+		return alignStride(stride, m_vertexLayout.strideAlignment);
+	};
+
+	vector<VertexAttribute> attributes;
+	uint32 stride = buildLayout(m_pruneUnusedAttributes, attributes);
+	stats.prunedBytesPerVertex = 0;
+	if (m_pruneUnusedAttributes && !(exportMesh.useTexCoords && exportMesh.useTangentFrame && exportMesh.useColors))
+	{
+		vector<VertexAttribute> allAttributes;
+		stats.prunedBytesPerVertex = buildLayout(false, allAttributes) - stride;
+	}
 
 	// Unpack Matrix
 	// From the PowerVR Support:
@@ -415,283 +1539,256 @@ void PODWriter::writeMeshBlock(uint index)
 	and scaling per coordinate. I think in your case, if you export all values as floats you 
 	can ignore it and set it to identity.                                   */
 	/************************************************************************/
-	writeStartTag(pod::e_meshUnpackMatrix, 4 * 16);
-	mat4 transposed;
-	write4ByteArray(m_fileStream, &transposed[0][0], 16);
-	writeEndTag(pod::e_meshUnpackMatrix);
+	mat4 unpackMatrix = calcUnpackMatrix(meshData.positions, findVertexAttribute(attributes, pod::e_meshVertexList)->type);
+	writeStartTag(out, pod::e_meshUnpackMatrix, 4 * 16);
+	mat4 transposed = unpackMatrix;
+	transposed.Transpose();
+	write4ByteArray(out, &transposed[0][0], 16);
+	writeEndTag(out, pod::e_meshUnpackMatrix);
+
+	// UV Unpack (normalized UVs that had to be remapped only, see setRemapUVs)
+	vec2 uvOffset, uvScale;
+	for (uint i = 0; i < attributes.size(); ++i)
+	{
+		if (attributes[i].identifier == pod::e_meshUVWList)
+		{
+			calcUVUnpack(meshData.texCoords, attributes[i].type, uvOffset, uvScale);
+		}
+		if (attributes[i].identifier == pod::e_meshUVWList && (uvOffset != vec2(0.0f, 0.0f) || uvScale != vec2(1.0f, 1.0f)))
+		{
+			float uvUnpack[4] = { uvOffset.x, uvOffset.y, uvScale.x, uvScale.y };
+			writeStartTag(out, pod::e_meshUVWUnpack, 4 * 4);
+			write4ByteArray(out, uvUnpack, 4);
+			writeEndTag(out, pod::e_meshUVWUnpack);
+		}
+	}
 
 	// Num. Faces
-	writeStartTag(pod::e_meshNumFaces, 4);
-	write4Bytes(m_fileStream, (uint32)meshData.numFaces);
-	writeEndTag(pod::e_meshNumFaces);
+	writeStartTag(out, pod::e_meshNumFaces, 4);
+	write4Bytes(out, (uint32)meshData.numFaces);
+	writeEndTag(out, pod::e_meshNumFaces);
 
 	// Num. UVW channels (currently only support 1 UV channel)
-	uint32 numUVW = meshData.texCoords.size() > 0 ? 1 : 0;
-	writeStartTag(pod::e_meshNumUVWChannels, 4);
-	write4Bytes(m_fileStream, numUVW);
-	writeEndTag(pod::e_meshNumUVWChannels);
-
-	// Get vertex attributes buffers from the model loader
-	vector<vec3> positionBuffer = meshData.positions;
-	vector<vec3> normalBuffer = meshData.normals;
-	vector<vec3> tangentBuffer = meshData.tangents;
-	vector<vec3> bitangentBuffer = meshData.bitangents;
-	vector<color4D> colorBuffer = meshData.colors;
-	vector<vec2> uvBuffer = meshData.texCoords;
-	vector<VertexBoneData> boneBuffer = meshData.bones;
+	uint32 numUVW = 0;
+	for (uint i = 0; i < attributes.size(); ++i)
+	{
+		if (attributes[i].identifier == pod::e_meshUVWList) ++numUVW;
+	}
+	writeStartTag(out, pod::e_meshNumUVWChannels, 4);
+	write4Bytes(out, numUVW);
+	writeEndTag(out, pod::e_meshNumUVWChannels);
+
+	// construct the interleaved data list, in the formats it is written in
+	vector<char> vertexData(stride * meshData.numVertices);
+	stats.attributes.resize(attributes.size());
+	for (uint i = 0; i < attributes.size(); ++i)
+	{
+		const VertexAttribute& attribute = attributes[i];
+		MeshExportStats::Attribute attributeStats = { attribute.identifier, attribute.type, attribute.numComponents,
+			encodeMeshAttribute(vertexData, stride, attribute, meshData, unpackMatrix, uvOffset, uvScale) };
+		if (attribute.identifier == pod::e_meshVertexList) attributeStats.error *= positionScale;
+		stats.attributes[i] = attributeStats;
+	}
 
 	// Index buffer
 	vector<uint32> indexBuffer = meshData.indices;
+	uint numVertices = meshData.numVertices;
 
+	CPVRTBoneBatches boneBatches;
 	if (m_exportSkinningData)
 	{
-		// construct the interleaved data list
-		uint32 stride = sizeof(positionBuffer[0]) + sizeof(boneBuffer[0]);
-		if (normalBuffer.size() > 0) stride += sizeof(normalBuffer[0]);
-		if (tangentBuffer.size() > 0) stride += sizeof(tangentBuffer[0]);
-		if (bitangentBuffer.size() > 0) stride += sizeof(bitangentBuffer[0]);
-		if (uvBuffer.size() > 0) stride += sizeof(uvBuffer[0]);
-		if (colorBuffer.size() > 0) stride += sizeof(colorBuffer[0]);
+		const VertexAttribute& boneIndices = *findVertexAttribute(attributes, pod::e_meshBoneIndexList);
+		const VertexAttribute& boneWeights = *findVertexAttribute(attributes, pod::e_meshBoneWeightList);
 
-		vector<char> interleavedDataList;
+		vector<BatchVertex> batchVertices(meshData.numVertices);
 		for (uint i = 0; i < meshData.numVertices; ++i)
 		{
-			addByteIntoVector(positionBuffer[i], interleavedDataList);
-
-			if (normalBuffer.size() > 0)
-				addByteIntoVector(normalBuffer[i], interleavedDataList);
-
-			if (tangentBuffer.size() > 0)
-				addByteIntoVector(tangentBuffer[i], interleavedDataList);
-
-			if (bitangentBuffer.size() > 0)
-				addByteIntoVector(bitangentBuffer[i], interleavedDataList);
-
-			if (uvBuffer.size() > 0)
-				addByteIntoVector(uvBuffer[i], interleavedDataList);
-
-			if (colorBuffer.size() > 0)
-				addByteIntoVector(colorBuffer[i], interleavedDataList);
-
-			addByteIntoVector(boneBuffer[i], interleavedDataList);
+			memcpy(batchVertices[i].weights, &vertexData[i * stride + boneWeights.offset], getVertexAttributeSize(boneWeights.type, boneWeights.numComponents));
+			memcpy(batchVertices[i].ids, meshData.bones[i].IDs, sizeof(batchVertices[i].ids));
+			batchVertices[i].source = i;
 		}
 
-		CPVRTBoneBatches boneBatches;
 		int    nVtxOut;
 		char    *pVtxOut;
-
-		int idOffset = stride - sizeof(boneBuffer[0]);
 		boneBatches.Create(&nVtxOut, &pVtxOut, indexBuffer.data(), meshData.numVertices,
-			interleavedDataList.data(), stride,
-			idOffset + 4 * sizeof(uint16), EPODDataFloat,
-			idOffset, EPODDataUnsignedShort,
+			reinterpret_cast<const char*>(batchVertices.data()), sizeof(BatchVertex),
+			offsetof(BatchVertex, weights), (EPVRTDataType)boneWeights.type,
+			offsetof(BatchVertex, ids), EPODDataUnsignedShort,
 			meshData.numFaces, MAX_NUM_BONES_PER_BATCH, NUM_BONES_PER_VEREX);
 
-		// Num. Vertices
-		writeStartTag(pod::e_meshNumVertices, 4);
-		write4Bytes(m_fileStream, nVtxOut);
-		writeEndTag(pod::e_meshNumVertices);
-
-		// Max. Num. Bones per Batch 
-		writeStartTag(pod::e_meshMaxNumBonesPerBatch, 4);
-		write4Bytes(m_fileStream, boneBatches.nBatchBoneMax);
-		writeEndTag(pod::e_meshMaxNumBonesPerBatch);
-
-		// Num. Bone Batches 
-		writeStartTag(pod::e_meshNumBoneBatches, 4);
-		write4Bytes(m_fileStream, boneBatches.nBatchCnt);
-		writeEndTag(pod::e_meshNumBoneBatches);
-
-		// Num. Bone Indices per Batch 
-		// A list of integers, each integer representing the number of indices in each batch in the "Bone Batch Index List"
-		writeStartTag(pod::e_meshNumBoneIndicesPerBatch, 4 * boneBatches.nBatchCnt);
-		write4ByteArray(m_fileStream, boneBatches.pnBatchBoneCnt, boneBatches.nBatchCnt);
-		writeEndTag(pod::e_meshNumBoneIndicesPerBatch);
-
-		// Bone Batch Index List 
-		// A list of indices into the "Node" list, each indexed "Node" representing the transformations associated with a single bone. 
-		// (Read via "Bone Index List"). 
-		writeStartTag(pod::e_meshBoneBatchIndexList, 4 * boneBatches.nBatchBoneMax * boneBatches.nBatchCnt);
-		write4ByteArray(m_fileStream, boneBatches.pnBatches, boneBatches.nBatchBoneMax * boneBatches.nBatchCnt);
-		writeEndTag(pod::e_meshBoneBatchIndexList);
-
-		// Bone Offset per Batch
-		// A list of integers, each integer representing the offset into the "Vertex List", 
-		// or "Vertex Index List" of the data is indexed, the batch starts at. 
-		writeStartTag(pod::e_meshBoneOffsetPerBatch, 4 * boneBatches.nBatchCnt);
-		write4ByteArray(m_fileStream, boneBatches.pnBatchOffset, boneBatches.nBatchCnt);
-		writeEndTag(pod::e_meshBoneOffsetPerBatch);
-
-		// Interleaved data list
-		writeStartTag(pod::e_meshInterleavedDataList, stride * nVtxOut);
-		writeByteArray(m_fileStream, pVtxOut, stride * nVtxOut);
-		writeEndTag(pod::e_meshInterleavedDataList);
-		FREE(pVtxOut);
-
-		// Vertex Index List
-		writeStartTag(pod::e_meshVertexIndexList, sizeof(uint32) * indexBuffer.size());
-		writeVertexIndexData<uint32>(m_fileStream, indexBuffer);
-		writeEndTag(pod::e_meshVertexIndexList);
-
-		// Dummy Vertex Attribute Lists (as all the vertex data is in the interleaved data list)
-		uint32 offset = 0;
-		writeStartTag(pod::e_meshVertexList, 0);
-		writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-		offset += DataType::size(DataType::Float32) * 3;
-		writeEndTag(pod::e_meshVertexList);
-
-		if (normalBuffer.size() > 0)
+		// the vertices used by several batches are duplicated, each copy gets the bone indices of its batch
+		const BatchVertex* batchedVertices = reinterpret_cast<const BatchVertex*>(pVtxOut);
+		vector<uint32> batchSources(nVtxOut);
+		for (int i = 0; i < nVtxOut; ++i)
 		{
-			writeStartTag(pod::e_meshNormalList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-			offset += DataType::size(DataType::Float32) * 3;
-			writeEndTag(pod::e_meshNormalList);
+			batchSources[i] = batchedVertices[i].source;
 		}
-		
-		if (tangentBuffer.size() > 0)
+		vector<char> batchedVertexData(stride * nVtxOut);
+		VertexInterleaver::gatherVertices(batchedVertexData.data(), vertexData.data(), stride, batchSources.data(), nVtxOut);
+		for (int i = 0; i < nVtxOut; ++i)
 		{
-			writeStartTag(pod::e_meshTangentList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-			offset += DataType::size(DataType::Float32) * 3;
-			writeEndTag(pod::e_meshTangentList);
+			const BatchVertex& batchVertex = batchedVertices[i];
+			PVRTVECTOR4f ids;
+			PVRTVertexRead(&ids, batchVertex.ids, EPODDataUnsignedShort, NUM_BONES_PER_VEREX);
+			PVRTVertexWrite(&batchedVertexData[i * stride + boneIndices.offset], (EPVRTDataType)boneIndices.type, boneIndices.numComponents, &ids);
 		}
+		vertexData.swap(batchedVertexData);
+		numVertices = nVtxOut;
+		FREE(pVtxOut);
+
+		// the bone batching reorders the triangles, so the cache optimization has to come after it
+		optimizeIndexBuffer(index, indexBuffer, numVertices, boneBatches.pnBatchOffset, boneBatches.nBatchCnt);
+	}
+	else
+	{
+		optimizeIndexBuffer(index, indexBuffer, numVertices);
+	}
 
-		if (bitangentBuffer.size() > 0)
+	// the batches are stored one after the other in the index list, so numbering the vertices by first
+	// use keeps the vertices each batch introduces in one contiguous range. The vertices the batching
+	// duplicated away are not referenced anymore and get dropped.
+	vector<uint32> vertexRemap;
+	numVertices = optimizeVertexOrder(indexBuffer, numVertices, vertexRemap);
+	vector<char> orderedVertexData(stride * numVertices);
+	VertexInterleaver::gatherVertices(orderedVertexData.data(), vertexData.data(), stride, vertexRemap.data(), numVertices);
+
+	// Split vertex streams: the attributes of the position stream are taken out of the interleaved vertices,
+	// each one into a tightly packed list of its own
+	vector<bool> inPositionStream(attributes.size(), false);
+	vector<vector<char>> positionStreamData(attributes.size());
+	if (m_vertexStreamMode != InterleavedStream)
+	{
+		vector<VertexAttribute> interleavedAttributes(attributes);
+		uint32 interleavedStride = 0;
+		for (uint i = 0; i < attributes.size(); ++i)
 		{
-			writeStartTag(pod::e_meshBinormalList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-			offset += DataType::size(DataType::Float32) * 3;
-			writeEndTag(pod::e_meshBinormalList);
+			uint32 identifier = attributes[i].identifier;
+			inPositionStream[i] = identifier == pod::e_meshVertexList || identifier == pod::e_meshBoneIndexList || identifier == pod::e_meshBoneWeightList ||
+				(identifier == pod::e_meshUVWList && m_vertexStreamMode == HotColdStreams);
+			if (!inPositionStream[i])
+			{
+				interleavedAttributes[i].offset = interleavedStride;
+				interleavedStride += getVertexAttributeSize(attributes[i].type, attributes[i].numComponents);
+			}
 		}
 
-		if (uvBuffer.size() > 0)
+		if (interleavedStride > 0)
 		{
-			writeStartTag(pod::e_meshUVWList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 2, stride, offset);
-			offset += DataType::size(DataType::Float32) * 2;
-			writeEndTag(pod::e_meshUVWList);
+			interleavedStride = alignStride(interleavedStride, m_vertexLayout.strideAlignment);
+			vector<char> interleavedData(interleavedStride * numVertices);
+			for (uint i = 0; i < attributes.size(); ++i)
+			{
+				const VertexAttribute& attribute = attributes[i];
+				if (inPositionStream[i])
+				{
+					uint32 size = getVertexAttributeSize(attribute.type, attribute.numComponents);
+					positionStreamData[i].resize(size * numVertices);
+					VertexInterleaver::writeAttribute(positionStreamData[i].data(), size, numVertices,
+						attribute.type, attribute.numComponents, &orderedVertexData[attribute.offset], attribute.type, stride);
+				}
+				else
+				{
+					VertexInterleaver::writeAttribute(interleavedData.data() + interleavedAttributes[i].offset, interleavedStride, numVertices,
+						attribute.type, attribute.numComponents, &orderedVertexData[attribute.offset], attribute.type, stride);
+				}
+			}
+			attributes.swap(interleavedAttributes);
+			orderedVertexData.swap(interleavedData);
+			stride = interleavedStride;
 		}
-
-		if (colorBuffer.size() > 0)
+		else
 		{
-			writeStartTag(pod::e_meshVertexColorList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 4, stride, offset);
-			offset += DataType::size(DataType::Float32) * 4;
-			writeEndTag(pod::e_meshVertexColorList);
+			inPositionStream.assign(attributes.size(), false);
 		}
-
-		writeStartTag(pod::e_meshBoneIndexList, 0);
-		writeVertexAttributeOffset(m_fileStream, DataType::UInt16, 4, stride, offset);
-		offset += DataType::size(DataType::UInt16) * 4;
-		writeEndTag(pod::e_meshBoneIndexList);
-
-		writeStartTag(pod::e_meshBoneWeightList, 0);
-		writeVertexAttributeOffset(m_fileStream, DataType::Float32, 4, stride, offset);
-		offset += DataType::size(DataType::Float32) * 4;
-		writeEndTag(pod::e_meshBoneWeightList);
 	}
-	else
-	{
-		// Num. Vertices
-		writeStartTag(pod::e_meshNumVertices, 4);
-		write4Bytes(m_fileStream, (uint32)meshData.numVertices);
-		writeEndTag(pod::e_meshNumVertices);
 
-		// Interleaved Data List
-		// Structure: position.xyz + normal.xyz + tangetn.xyz + UV.xy
-		uint32 stride = sizeof(positionBuffer[0]);
-
-		if (normalBuffer.size() > 0) stride += sizeof(normalBuffer[0]);
-		if (tangentBuffer.size() > 0) stride += sizeof(tangentBuffer[0]);
-		if (bitangentBuffer.size() > 0) stride += sizeof(bitangentBuffer[0]);
-		if (uvBuffer.size() > 0) stride += sizeof(uvBuffer[0]);
-		if (colorBuffer.size() > 0) stride += sizeof(colorBuffer[0]);
-
-		writeStartTag(pod::e_meshInterleavedDataList, stride * meshData.numVertices);
-		for (uint i = 0; i < meshData.numVertices; ++i)
-		{
-			writeBytes(m_fileStream, positionBuffer[i]);
+	stats.numVertices = numVertices;
 
-			if (normalBuffer.size() > 0)
-				writeBytes(m_fileStream, normalBuffer[i]);
+	// Num. Vertices
+	writeStartTag(out, pod::e_meshNumVertices, 4);
+	write4Bytes(out, (uint32)numVertices);
+	writeEndTag(out, pod::e_meshNumVertices);
 
-			if (tangentBuffer.size() > 0)
-				writeBytes(m_fileStream, tangentBuffer[i]);
+	if (m_exportSkinningData)
+	{
+		// Max. Num. Bones per Batch 
+		writeStartTag(out, pod::e_meshMaxNumBonesPerBatch, 4);
+		write4Bytes(out, boneBatches.nBatchBoneMax);
+		writeEndTag(out, pod::e_meshMaxNumBonesPerBatch);
 
-			if (bitangentBuffer.size() > 0)
-				writeBytes(m_fileStream, bitangentBuffer[i]);
+		// Num. Bone Batches 
+		writeStartTag(out, pod::e_meshNumBoneBatches, 4);
+		write4Bytes(out, boneBatches.nBatchCnt);
+		writeEndTag(out, pod::e_meshNumBoneBatches);
 
-			if (uvBuffer.size() > 0)
-				writeBytes(m_fileStream, uvBuffer[i]);
+		// Num. Bone Indices per Batch 
+		// A list of integers, each integer representing the number of indices in each batch in the "Bone Batch Index List"
+		writeStartTag(out, pod::e_meshNumBoneIndicesPerBatch, 4 * boneBatches.nBatchCnt);
+		write4ByteArray(out, boneBatches.pnBatchBoneCnt, boneBatches.nBatchCnt);
+		writeEndTag(out, pod::e_meshNumBoneIndicesPerBatch);
 
-			if (colorBuffer.size() > 0)
-				writeBytes(m_fileStream, colorBuffer[i]);
+		// Bone Batch Index List 
+		// A list of indices into the "Node" list, each indexed "Node" representing the transformations associated with a single bone. 
+		// (Read via "Bone Index List"). 
+		writeStartTag(out, pod::e_meshBoneBatchIndexList, 4 * boneBatches.nBatchBoneMax * boneBatches.nBatchCnt);
+		// the bone ids are indices into the loader's node list, turn them into indices of the written nodes
+		for (int i = 0; i < boneBatches.nBatchBoneMax * boneBatches.nBatchCnt; ++i)
+		{
+			boneBatches.pnBatches[i] = m_exportNodeIndices[boneBatches.pnBatches[i]];
 		}
-		writeEndTag(pod::e_meshInterleavedDataList);
+		write4ByteArray(out, boneBatches.pnBatches, boneBatches.nBatchBoneMax * boneBatches.nBatchCnt);
+		writeEndTag(out, pod::e_meshBoneBatchIndexList);
 
-		// Vertex Index List
-		writeStartTag(pod::e_meshVertexIndexList, sizeof(uint32) * indexBuffer.size());
-		writeVertexIndexData<uint32>(m_fileStream, indexBuffer);
-		writeEndTag(pod::e_meshVertexIndexList);
+		// Bone Offset per Batch
+		// A list of integers, each integer representing the offset into the "Vertex List", 
+		// or "Vertex Index List" of the data is indexed, the batch starts at. 
+		writeStartTag(out, pod::e_meshBoneOffsetPerBatch, 4 * boneBatches.nBatchCnt);
+		write4ByteArray(out, boneBatches.pnBatchOffset, boneBatches.nBatchCnt);
+		writeEndTag(out, pod::e_meshBoneOffsetPerBatch);
 
-		// Dummy Vertex Attribute Lists (as all the vertex data is in the interleaved data list)
-		uint32 offset = 0;
-		writeStartTag(pod::e_meshVertexList, 0);
-		writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-		offset += DataType::size(DataType::Float32) * 3;
-		writeEndTag(pod::e_meshVertexList);
+		boneBatches.Release();
+	}
 
-		if (normalBuffer.size() > 0)
-		{
-			writeStartTag(pod::e_meshNormalList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-			offset += DataType::size(DataType::Float32) * 3;
-			writeEndTag(pod::e_meshNormalList);
-		}
+	// Vertex Attribute Lists of the position stream, holding their own data. They come before the interleaved
+	// data list, as loaders read the data of the lists found after it as offsets into the interleaved data.
+	for (uint i = 0; i < attributes.size(); ++i)
+	{
+		if (!inPositionStream[i]) continue;
 
-		if (tangentBuffer.size() > 0)
-		{
-			writeStartTag(pod::e_meshTangentList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-			offset += DataType::size(DataType::Float32) * 3;
-			writeEndTag(pod::e_meshTangentList);
-		}
+		const VertexAttribute& attribute = attributes[i];
+		writeStartTag(out, attribute.identifier, 0);
+		writeVertexAttributeData(out, attribute.type, attribute.numComponents, getVertexAttributeSize(attribute.type, attribute.numComponents), positionStreamData[i]);
+		writeEndTag(out, attribute.identifier);
+	}
 
-		if (bitangentBuffer.size() > 0)
-		{
-			writeStartTag(pod::e_meshBinormalList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 3, stride, offset);
-			offset += DataType::size(DataType::Float32) * 3;
-			writeEndTag(pod::e_meshBinormalList);
-		}
+	// Interleaved data list
+	writeStartTag(out, pod::e_meshInterleavedDataList, stride * numVertices);
+	writeByteArray(out, orderedVertexData.data(), stride * numVertices);
+	writeEndTag(out, pod::e_meshInterleavedDataList);
 
-		if (uvBuffer.size() > 0) 
-		{
-			writeStartTag(pod::e_meshUVWList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 2, stride, offset);
-			offset += DataType::size(DataType::Float32) * 2;
-			writeEndTag(pod::e_meshUVWList);
-		}
+	// Vertex Index List
+	writeVertexIndexList(out, indexBuffer, numVertices, m_force32BitIndices);
 
-		if (colorBuffer.size() > 0)
-		{
-			writeStartTag(pod::e_meshVertexColorList, 0);
-			writeVertexAttributeOffset(m_fileStream, DataType::Float32, 4, stride, offset);
-			offset += DataType::size(DataType::Float32) * 4;
-			writeEndTag(pod::e_meshVertexColorList);
-		}
-	} // end if export skinning data
+	// Dummy Vertex Attribute Lists (as the rest of the vertex data is in the interleaved data list)
+	for (uint i = 0; i < attributes.size(); ++i)
+	{
+		if (inPositionStream[i]) continue;
+
+		const VertexAttribute& attribute = attributes[i];
+		writeStartTag(out, attribute.identifier, 0);
+		writeVertexAttributeOffset(out, attribute.type, attribute.numComponents, stride, attribute.offset);
+		writeEndTag(out, attribute.identifier);
+	}
 
-	writeEndTag(pod::e_sceneMesh);
+	writeEndTag(out, pod::e_sceneMesh);
 }
 
-void PODWriter::writeNodeBlock(uint index)
+void PODWriter::writeNodeBlock(uint index, PODBlockBuffer& out)
 {
-	aiNode* node = m_Nodes[index];
-	cout << "\n" << index << " " << node->mName.C_Str();
+	aiNode* node = m_Nodes[m_exportNodeSources[index]];
 
 	// write node block
-	writeStartTag(pod::e_sceneNode, 0);
+	writeStartTag(out, pod::e_sceneNode, 0);
 
 	// Node Index
 	// mesh node
@@ -717,62 +1814,34 @@ void PODWriter::writeNodeBlock(uint index)
 		}
 	}
 
-	writeStartTag(pod::e_nodeIndex, 4);
-	write4Bytes(m_fileStream, objectIndex);
-	writeEndTag(pod::e_nodeIndex);
+	writeStartTag(out, pod::e_nodeIndex, 4);
+	write4Bytes(out, objectIndex);
+	writeEndTag(out, pod::e_nodeIndex);
 
 	// Node Name
-	std::string nodeName(node->mName.C_Str());
-	writeStartTag(pod::e_nodeName, nodeName.length() + 1);
-	writeByteArrayFromeString(m_fileStream, nodeName);
-	writeEndTag(pod::e_nodeName);
+	std::string nodeName = getExportNodeName(index);
+	writeStartTag(out, pod::e_nodeName, nodeName.length() + 1);
+	writeByteArrayFromeString(out, nodeName);
+	writeEndTag(out, pod::e_nodeName);
 
 	// Material Index (if the node is a mesh)
 	int32 matIndex = node->mNumMeshes == 1 ? node->mMeshes[0] : -1;
-	writeStartTag(pod::e_nodeMaterialIndex, 4);
-	write4Bytes(m_fileStream, matIndex);
-	writeEndTag(pod::e_nodeMaterialIndex);
+	writeStartTag(out, pod::e_nodeMaterialIndex, 4);
+	write4Bytes(out, matIndex);
+	writeEndTag(out, pod::e_nodeMaterialIndex);
 
 	// Parent Index 
-	int32 parentIdx = -1;
-	for (uint i = 0; i < m_Nodes.size(); ++i)
-	{
-		if (m_Nodes[i] == node->mParent)
-		{
-			parentIdx = i;
-			break;
-		}
- 	}
+	int32 parentIdx = findExportNodeIndex(node->mParent);
 
-	writeStartTag(pod::e_nodeParentIndex, 4);
-	write4Bytes(m_fileStream, parentIdx);
-	writeEndTag(pod::e_nodeParentIndex);
-
-	// Node Animation
-	aiNodeAnim* animation = NULL;
-	if (m_modelLoader.getScene()->HasAnimations())
-	{
-		aiAnimation* anim = m_modelLoader.getScene()->mAnimations[0];
-		animation = m_animationHelper.findNodeAnim(anim, node->mName);
-	}
+	writeStartTag(out, pod::e_nodeParentIndex, 4);
+	write4Bytes(out, parentIdx);
+	writeEndTag(out, pod::e_nodeParentIndex);
 
+	// Node Animation: the frames resampled beforehand (the block owns them from now on), or the node's transformation
 	vector<mat4> nodeTransformations;
-	if (m_exportAnimations && animation)
+	if (index < m_nodeAnimations.size() && !m_nodeAnimations[index].empty())
 	{
-		// Re-sampling the animation
-		float frameInterval = (float)m_animationHelper.getFrameIntervalInTicks();
-		for (uint i = 0; i < m_animationHelper.getNumFrames(); ++i)
-		{
-			vec3 pos, scaling;
-			quat rot;
-
-			float frameTime = i * frameInterval;
-			m_animationHelper.calcInterpolatedPosition(pos, frameTime, animation);
-			m_animationHelper.calcInterpolatedRotation(rot, frameTime, animation);
-			m_animationHelper.calcInterpolatedScaling(scaling, frameTime, animation);
-
-			nodeTransformations.push_back(mat4(scaling, rot, pos));
-		}
+		nodeTransformations.swap(m_nodeAnimations[index]);
 	}
 	else
 	{
@@ -781,42 +1850,50 @@ void PODWriter::writeNodeBlock(uint index)
 
 	// Animation Flag
 	uint32 flag = nodeTransformations.size() > 1 ? 8 : 0;
-	writeStartTag(pod::e_nodeAnimationFlags, 4);
-	write4Bytes(m_fileStream, flag);
-	writeEndTag(pod::e_nodeAnimationFlags);
+	writeStartTag(out, pod::e_nodeAnimationFlags, 4);
+	write4Bytes(out, flag);
+	writeEndTag(out, pod::e_nodeAnimationFlags);
 
 	// Animation Matrix, 16 floats per frame of animation
-	writeStartTag(pod::e_nodeAnimationMatrix, sizeof(nodeTransformations[0]) * nodeTransformations.size());
+	writeStartTag(out, pod::e_nodeAnimationMatrix, sizeof(nodeTransformations[0]) * nodeTransformations.size());
 	for (uint i = 0; i < nodeTransformations.size(); ++i)
 	{
 		// this matrix need to be transposed to match the pod file matrix layout
 		// Assimp matrix is row-major while the pod matrix is column-major(they use glm) in memory
 		mat4 nodeTrans = nodeTransformations[i].Transpose();
-		write4ByteArray(m_fileStream, &nodeTrans[0][0], 16);
+		write4ByteArray(out, &nodeTrans[0][0], 16);
 	}
-	writeEndTag(pod::e_nodeAnimationMatrix);
+	writeEndTag(out, pod::e_nodeAnimationMatrix);
 
-	writeEndTag(pod::e_sceneNode);
+	writeEndTag(out, pod::e_sceneNode);
 }
 
-void PODWriter::writeMaterialBlock(uint index)
+void PODWriter::writeMaterialBlock(uint index, PODBlockBuffer& out)
 {
 	MaterialData matData = m_modelDataVec[index]->materialData;
 
+	// pruned constant vertex colours are carried by the material
+	const vector<color4D>& colors = m_modelDataVec[index]->meshData.colors;
+	if (m_pruneUnusedAttributes && !colors.empty() && !m_exportMeshes[m_exportNodeIndices[index]].useColors)
+	{
+		matData.diffuseColor = color4D(matData.diffuseColor.r * colors[0].r, matData.diffuseColor.g * colors[0].g, matData.diffuseColor.b * colors[0].b, matData.diffuseColor.a);
+		matData.opacity *= colors[0].a;
+	}
+
 	// write material block
-	writeStartTag(pod::e_sceneMaterial, 0);
+	writeStartTag(out, pod::e_sceneMaterial, 0);
 
 	// Material Flags (blending enabled/disabled)
 	uint32	flags = matData.blendMode > 0 ? 0x01 : 0x00;
-	writeStartTag(pod::e_materialFlags, 4);
-	write4Bytes(m_fileStream, flags);
-	writeEndTag(pod::e_materialFlags);
+	writeStartTag(out, pod::e_materialFlags, 4);
+	write4Bytes(out, flags);
+	writeEndTag(out, pod::e_materialFlags);
 
 	// Material Name
 	std::string name(matData.name);
-	writeStartTag(pod::e_materialName, name.length() + 1);
-	writeByteArrayFromeString(m_fileStream, name);
-	writeEndTag(pod::e_materialName);
+	writeStartTag(out, pod::e_materialName, name.length() + 1);
+	writeByteArrayFromeString(out, name);
+	writeEndTag(out, pod::e_materialName);
 
 	// Texture Index
 	// calculate the index offset
@@ -828,128 +1905,128 @@ void PODWriter::writeMaterialBlock(uint index)
 
 	int32 emptyTextureIndex = -1;
 
-	writeStartTag(pod::e_materialDiffuseTextureIndex, 4);
+	writeStartTag(out, pod::e_materialDiffuseTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_DIFFUSE].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialDiffuseTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialDiffuseTextureIndex);
 
-	writeStartTag(pod::e_materialAmbientTextureIndex, 4);
+	writeStartTag(out, pod::e_materialAmbientTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_AMBIENT].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialAmbientTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialAmbientTextureIndex);
 
-	writeStartTag(pod::e_materialSpecularColorTextureIndex, 4);
+	writeStartTag(out, pod::e_materialSpecularColorTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_SPECULAR].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialSpecularColorTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialSpecularColorTextureIndex);
 
-	writeStartTag(pod::e_materialSpecularLevelTextureIndex, 4);
+	writeStartTag(out, pod::e_materialSpecularLevelTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_HEIGHT].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialSpecularLevelTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialSpecularLevelTextureIndex);
 
-	writeStartTag(pod::e_materialBumpMapTextureIndex, 4);
+	writeStartTag(out, pod::e_materialBumpMapTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_NORMALS].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialBumpMapTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialBumpMapTextureIndex);
 
-	writeStartTag(pod::e_materialEmissiveTextureIndex, 4);
+	writeStartTag(out, pod::e_materialEmissiveTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_EMISSIVE].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialEmissiveTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialEmissiveTextureIndex);
 
-	writeStartTag(pod::e_materialGlossinessTextureIndex, 4);
+	writeStartTag(out, pod::e_materialGlossinessTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_SHININESS].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialGlossinessTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialGlossinessTextureIndex);
 
-	writeStartTag(pod::e_materialOpacityTextureIndex, 4);
+	writeStartTag(out, pod::e_materialOpacityTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_OPACITY].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialOpacityTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialOpacityTextureIndex);
 
-	writeStartTag(pod::e_materialReflectionTextureIndex, 4);
+	writeStartTag(out, pod::e_materialReflectionTextureIndex, 4);
 	if (!matData.textureData.texturesMap[aiTextureType_REFLECTION].empty())
 	{
-		write4Bytes(m_fileStream, offset);
+		write4Bytes(out, offset);
 		++offset;
 	}
 	else
-		write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialReflectionTextureIndex);
+		write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialReflectionTextureIndex);
 
 	// refraction map not supported
-	writeStartTag(pod::e_materialRefractionTextureIndex, 4);
-	write4Bytes(m_fileStream, emptyTextureIndex);
-	writeEndTag(pod::e_materialRefractionTextureIndex);
+	writeStartTag(out, pod::e_materialRefractionTextureIndex, 4);
+	write4Bytes(out, emptyTextureIndex);
+	writeEndTag(out, pod::e_materialRefractionTextureIndex);
 
 	//Opacity
-	writeStartTag(pod::e_materialOpacity, 4);
-	write4Bytes(m_fileStream, matData.opacity);
-	writeEndTag(pod::e_materialOpacity);
+	writeStartTag(out, pod::e_materialOpacity, 4);
+	write4Bytes(out, matData.opacity);
+	writeEndTag(out, pod::e_materialOpacity);
 
 	// Ambient Color
 	float32	ambientColor[3] = { matData.ambientColor.r, matData.ambientColor.g, matData.ambientColor.b };
-	writeStartTag(pod::e_materialAmbientColor, 3 * sizeof(float32));
-	write4ByteArray(m_fileStream, &ambientColor[0], 3);
-	writeEndTag(pod::e_materialAmbientColor);
+	writeStartTag(out, pod::e_materialAmbientColor, 3 * sizeof(float32));
+	write4ByteArray(out, &ambientColor[0], 3);
+	writeEndTag(out, pod::e_materialAmbientColor);
 
 	// Diffuse Color
 	float32	diffuseColor[3] = { matData.diffuseColor.r, matData.diffuseColor.g, matData.diffuseColor.b };
-	writeStartTag(pod::e_materialDiffuseColor, 3 * sizeof(float32));
-	write4ByteArray(m_fileStream, &diffuseColor[0], 3);
-	writeEndTag(pod::e_materialDiffuseColor);
+	writeStartTag(out, pod::e_materialDiffuseColor, 3 * sizeof(float32));
+	write4ByteArray(out, &diffuseColor[0], 3);
+	writeEndTag(out, pod::e_materialDiffuseColor);
 
 	// Specular Color
 	float32	specularColor[3] = { matData.specularColor.r, matData.specularColor.g, matData.specularColor.b };
-	writeStartTag(pod::e_materialSpecularColor, 3 * sizeof(float32));
-	write4ByteArray(m_fileStream, &specularColor[0], 3);
-	writeEndTag(pod::e_materialSpecularColor);
+	writeStartTag(out, pod::e_materialSpecularColor, 3 * sizeof(float32));
+	write4ByteArray(out, &specularColor[0], 3);
+	writeEndTag(out, pod::e_materialSpecularColor);
 
 	// Shininess
-	writeStartTag(pod::e_materialShininess, 4);
-	write4Bytes(m_fileStream, matData.shininess);
-	writeEndTag(pod::e_materialShininess);
+	writeStartTag(out, pod::e_materialShininess, 4);
+	write4Bytes(out, matData.shininess);
+	writeEndTag(out, pod::e_materialShininess);
 
 	// Blend Function
 	uint32 blendFuncSource, blendFuncDest, blendOperation;
@@ -975,38 +2052,38 @@ void PODWriter::writeMaterialBlock(uint index)
 	}
 
 	// RGBA
-	writeStartTag(pod::e_materialBlendingRGBSrc, 4);
-	write4Bytes(m_fileStream, blendFuncSource);
-	writeEndTag(pod::e_materialBlendingRGBSrc);
+	writeStartTag(out, pod::e_materialBlendingRGBSrc, 4);
+	write4Bytes(out, blendFuncSource);
+	writeEndTag(out, pod::e_materialBlendingRGBSrc);
 
-	writeStartTag(pod::e_materialBlendingAlphaSrc, 4);
-	write4Bytes(m_fileStream, blendFuncSource);
-	writeEndTag(pod::e_materialBlendingAlphaSrc);
+	writeStartTag(out, pod::e_materialBlendingAlphaSrc, 4);
+	write4Bytes(out, blendFuncSource);
+	writeEndTag(out, pod::e_materialBlendingAlphaSrc);
 
-	writeStartTag(pod::e_materialBlendingRGBDst, 4);
-	write4Bytes(m_fileStream, blendFuncDest);
-	writeEndTag(pod::e_materialBlendingRGBDst);
+	writeStartTag(out, pod::e_materialBlendingRGBDst, 4);
+	write4Bytes(out, blendFuncDest);
+	writeEndTag(out, pod::e_materialBlendingRGBDst);
 
-	writeStartTag(pod::e_materialBlendingAlphaDst, 4);
-	write4Bytes(m_fileStream, blendFuncDest);
-	writeEndTag(pod::e_materialBlendingAlphaDst);
+	writeStartTag(out, pod::e_materialBlendingAlphaDst, 4);
+	write4Bytes(out, blendFuncDest);
+	writeEndTag(out, pod::e_materialBlendingAlphaDst);
 
 	// Blend Operation
-	writeStartTag(pod::e_materialBlendingRGBOperation, 4);
-	write4Bytes(m_fileStream, blendOperation);
-	writeEndTag(pod::e_materialBlendingRGBOperation);
+	writeStartTag(out, pod::e_materialBlendingRGBOperation, 4);
+	write4Bytes(out, blendOperation);
+	writeEndTag(out, pod::e_materialBlendingRGBOperation);
 
-	writeStartTag(pod::e_materialBlendingAlphaOperation, 4);
-	write4Bytes(m_fileStream, blendOperation);
-	writeEndTag(pod::e_materialBlendingAlphaOperation);
+	writeStartTag(out, pod::e_materialBlendingAlphaOperation, 4);
+	write4Bytes(out, blendOperation);
+	writeEndTag(out, pod::e_materialBlendingAlphaOperation);
 
-	writeEndTag(pod::e_sceneMaterial);
+	writeEndTag(out, pod::e_sceneMaterial);
 }
 
-void PODWriter::writeTextureBlock(uint index)
+void PODWriter::writeTextureBlock(uint index, PODBlockBuffer& out)
 {
 	// write texture block
-	writeStartTag(pod::e_sceneTexture, 0);
+	writeStartTag(out, pod::e_sceneTexture, 0);
 
 	// Texture Name (file path not included as stated in the document)
 	std::string path = m_modelLoader.getTexture(index);
@@ -1025,17 +2102,17 @@ void PODWriter::writeTextureBlock(uint index)
 	}
 
 	std::string name(path);
-	writeStartTag(pod::e_textureFilename, name.length() + 1);
-	writeByteArrayFromeString(m_fileStream, name);
-	writeEndTag(pod::e_textureFilename);
+	writeStartTag(out, pod::e_textureFilename, name.length() + 1);
+	writeByteArrayFromeString(out, name);
+	writeEndTag(out, pod::e_textureFilename);
 
-	writeEndTag(pod::e_sceneTexture);
+	writeEndTag(out, pod::e_sceneTexture);
 }
 
-void PODWriter::writeLightBlock(uint index)
+void PODWriter::writeLightBlock(uint index, PODBlockBuffer& out)
 {
 	// write light block
-	writeStartTag(pod::e_sceneLight, 0);
+	writeStartTag(out, pod::e_sceneLight, 0);
 
 	aiLight* light = m_modelLoader.getScene()->mLights[index];
 	aiNode* lightNode = m_modelLoader.getScene()->mRootNode->FindNode(light->mName);
@@ -1048,20 +2125,13 @@ void PODWriter::writeLightBlock(uint index)
 		aiNode* targetNode = m_modelLoader.getScene()->mRootNode->FindNode((std::string(light->mName.C_Str()) + ".Target").c_str());
 		if (targetNode)
 		{
-			for (uint i = 0; i < m_Nodes.size(); ++i)
-			{
-				if (m_Nodes[i] == targetNode)
-				{
-					targetObjIndex = i;
-					break;
-				}
-			}
+			targetObjIndex = findExportNodeIndex(targetNode);
 		}
 	}
 
-	writeStartTag(pod::e_lightTargetObjectIndex, 4);
-	write4Bytes(m_fileStream, targetObjIndex);
-	writeEndTag(pod::e_lightTargetObjectIndex);
+	writeStartTag(out, pod::e_lightTargetObjectIndex, 4);
+	write4Bytes(out, targetObjIndex);
+	writeEndTag(out, pod::e_lightTargetObjectIndex);
 
 	// light color (RGB, 3 floats)
 	// TODO: Do we need to clamp it?
@@ -1069,9 +2139,9 @@ void PODWriter::writeLightBlock(uint index)
 		CLAMP(light->mColorDiffuse.g / 256.0f, 0.0f, 1.0f),
 		CLAMP(light->mColorDiffuse.b / 256.0f, 0.0f, 1.0f) };
 
-	writeStartTag(pod::e_lightColor, 3 * 4);
-	write4ByteArray(m_fileStream, lightColor, 3);
-	writeEndTag(pod::e_lightColor);
+	writeStartTag(out, pod::e_lightColor, 3 * 4);
+	write4ByteArray(out, lightColor, 3);
+	writeEndTag(out, pod::e_lightColor);
 
 	// light type (point = 0, directional = 1, spot = 2)
 	uint32 lightType;
@@ -1090,46 +2160,46 @@ void PODWriter::writeLightBlock(uint index)
 		lightType = 0;
 		break;
 	}
-	writeStartTag(pod::e_lightType, 4);
-	write4Bytes(m_fileStream, lightType);
-	writeEndTag(pod::e_lightType);
+	writeStartTag(out, pod::e_lightType, 4);
+	write4Bytes(out, lightType);
+	writeEndTag(out, pod::e_lightType);
 
 	// constant attenuation
-	writeStartTag(pod::e_lightConstantAttenuation, 4);
-	write4Bytes(m_fileStream, light->mAttenuationConstant);
-	writeEndTag(pod::e_lightConstantAttenuation);
+	writeStartTag(out, pod::e_lightConstantAttenuation, 4);
+	write4Bytes(out, light->mAttenuationConstant);
+	writeEndTag(out, pod::e_lightConstantAttenuation);
 
 	// linear attenuation
-	writeStartTag(pod::e_lightLinearAttenuation, 4);
-	write4Bytes(m_fileStream, light->mAttenuationLinear);
-	writeEndTag(pod::e_lightLinearAttenuation);
+	writeStartTag(out, pod::e_lightLinearAttenuation, 4);
+	write4Bytes(out, light->mAttenuationLinear);
+	writeEndTag(out, pod::e_lightLinearAttenuation);
 
 	// quadratic attenuation
-	writeStartTag(pod::e_lightQuadraticAttenuation, 4);
-	write4Bytes(m_fileStream, light->mAttenuationQuadratic);
-	writeEndTag(pod::e_lightQuadraticAttenuation);
+	writeStartTag(out, pod::e_lightQuadraticAttenuation, 4);
+	write4Bytes(out, light->mAttenuationQuadratic);
+	writeEndTag(out, pod::e_lightQuadraticAttenuation);
 
 	if (light->mType == aiLightSource_SPOT)
 	{
 		// falloff angle
-		writeStartTag(pod::e_lightFalloffAngle, 4);
-		write4Bytes(m_fileStream, light->mAngleOuterCone);
-		writeEndTag(pod::e_lightFalloffAngle);
+		writeStartTag(out, pod::e_lightFalloffAngle, 4);
+		write4Bytes(out, light->mAngleOuterCone);
+		writeEndTag(out, pod::e_lightFalloffAngle);
 
 		// falloff exponent
 		float falloffExponent = 0.0f;
-		writeStartTag(pod::e_lightFalloffExponent, 4);
-		write4Bytes(m_fileStream, falloffExponent);
-		writeEndTag(pod::e_lightFalloffExponent);
+		writeStartTag(out, pod::e_lightFalloffExponent, 4);
+		write4Bytes(out, falloffExponent);
+		writeEndTag(out, pod::e_lightFalloffExponent);
 	}
 	
-	writeEndTag(pod::e_sceneLight);
+	writeEndTag(out, pod::e_sceneLight);
 }
 
-void PODWriter::writeCameraBlock(uint index)
+void PODWriter::writeCameraBlock(uint index, PODBlockBuffer& out)
 {
 	// write camera block
-	writeStartTag(pod::e_sceneCamera, 0);
+	writeStartTag(out, pod::e_sceneCamera, 0);
 
 	aiCamera* camera = m_modelLoader.getScene()->mCameras[index];
 	aiNode* cameraNode = m_modelLoader.getScene()->mRootNode->FindNode(camera->mName);
@@ -1140,36 +2210,29 @@ void PODWriter::writeCameraBlock(uint index)
 	int32 targetObjIndex = -1;
 	if (targetNode)
 	{
-		for (uint i = 0; i < m_Nodes.size(); ++i)
-		{
-			if (m_Nodes[i] == targetNode)
-			{
-				targetObjIndex = i;
-				break;
-			}
-		}
+		targetObjIndex = findExportNodeIndex(targetNode);
 	}
 
-	writeStartTag(pod::e_cameraTargetObjectIndex, 4);
-	write4Bytes(m_fileStream, targetObjIndex);
-	writeEndTag(pod::e_cameraTargetObjectIndex);
+	writeStartTag(out, pod::e_cameraTargetObjectIndex, 4);
+	write4Bytes(out, targetObjIndex);
+	writeEndTag(out, pod::e_cameraTargetObjectIndex);
 	
 	// FOV
- 	writeStartTag(pod::e_cameraFOV, 4);
- 	write4Bytes(m_fileStream, camera->mHorizontalFOV);
- 	writeEndTag(pod::e_cameraFOV);
+ 	writeStartTag(out, pod::e_cameraFOV, 4);
+ 	write4Bytes(out, camera->mHorizontalFOV);
+ 	writeEndTag(out, pod::e_cameraFOV);
 
 	// far clip
-	writeStartTag(pod::e_cameraFarPlane, 4);
-	write4Bytes(m_fileStream, camera->mClipPlaneFar);
-	writeEndTag(pod::e_cameraFarPlane);
+	writeStartTag(out, pod::e_cameraFarPlane, 4);
+	write4Bytes(out, camera->mClipPlaneFar);
+	writeEndTag(out, pod::e_cameraFarPlane);
 
 	// near clip
-	writeStartTag(pod::e_cameraNearPlane, 4);
-	write4Bytes(m_fileStream, camera->mClipPlaneNear);
-	writeEndTag(pod::e_cameraNearPlane);
+	writeStartTag(out, pod::e_cameraNearPlane, 4);
+	write4Bytes(out, camera->mClipPlaneNear);
+	writeEndTag(out, pod::e_cameraNearPlane);
 
-	writeEndTag(pod::e_sceneCamera);
+	writeEndTag(out, pod::e_sceneCamera);
 }
 
 }
@@ -1,7 +1,10 @@
-#pragma once
+﻿#pragma once
 #include "ModelLoader.h"
 #include "PODDefines.h"
 #include "AnimationHelper.h"
+#include "PODBlockBuffer.h"
+#include "WorkerPool.h"
+#include "AsyncFileWriter.h"
 #include <fstream>
 using std::vector;
 
@@ -20,22 +23,174 @@ public:
 		ExportEverything = 0x03
 	};
 
+	enum OutputMode
+	{
+		StreamOutput,	// blocks are written through a file stream as soon as they are serialized
+		AsyncOutput		// filled buffers are written by a dedicated I/O thread while the next blocks are serialized
+	};
+
+	enum TangentFrameMode
+	{
+		SeparateTangentFrame,	// normal, tangent and bitangent
+		TangentWithSign,		// normal, and the tangent with the handedness in w: bitangent = cross(normal, tangent) * w
+		QTangent				// a quaternion in the normal list turning x, y, z into tangent, bitangent, normal (bitangent negated if w < 0)
+	};
+
+	enum VertexStreamMode
+	{
+		InterleavedStream,	// all the attributes in the interleaved data list
+		PositionStream,		// the positions in a stream of their own, for the depth and shadow passes (with the bone indices and weights if skinned)
+		HotColdStreams		// the UVs in the position stream too, the tangent frames and colours in the interleaved data list
+	};
+
+	// The interleaved vertex layout: the attributes in the order they are stored in a vertex, and the alignment
+	// the stride is padded to (1 for no padding, 16 or 32 for GPUs that fetch whole cache lines).
+	struct VertexLayout
+	{
+		struct Attribute
+		{
+			uint32 identifier;		// the list describing it: pod::e_meshVertexList, pod::e_meshNormalList...
+			DataType::Enum format;	// DataType::None for the format given to setAttributeFormat (or picked by the automatic quantization)
+		};
+
+		vector<Attribute> attributes;
+		uint32 strideAlignment;
+	};
+
 	PODWriter(ModelLoader& loader);
 
+	// position, normal, tangent, bitangent, UV, colour, bone indices and bone weights, packed
+	static VertexLayout getDefaultVertexLayout();
+
 	void exportModel(const std::string& path, ExportOptions options = ExportEverything);
 	void setModels(vector<ModelDataPtr>& models) { m_modelDataVec = models; }
 
+	// number of threads used to serialize the mesh, material and node blocks (0 = one per core)
+	void setNumThreads(uint numThreads) { m_numThreads = numThreads; }
+	void setOutputMode(OutputMode mode) { m_outputMode = mode; }
+
+	// reorder the triangles of every mesh (of every bone batch for skinned meshes) for the post-transform vertex cache.
+	// Off by default, which keeps the triangle order of the loaded meshes.
+	void setOptimizeVertexCache(bool optimize) { m_optimizeVertexCache = optimize; }
+	// store the vertices in the order the index list uses them (unused vertices are dropped). Off by default,
+	// which keeps the vertex order and count of the loaded meshes.
+	void setOptimizeVertexFetch(bool optimize) { m_optimizeVertexFetch = optimize; }
+	// meshes with at most 65536 vertices get 16 bit indices unless this is set
+	void setForce32BitIndices(bool force) { m_force32BitIndices = force; }
+	// split the meshes that have too many vertices for 16 bit indices, each part gets its own node
+	void setSplitLargeMeshes(bool split) { m_splitLargeMeshes = split; }
+
+	// storage format of a vertex attribute, given by the list describing it:
+	//   pod::e_meshVertexList: Float32, or Int16Norm/UInt16Norm relative to the bounding box of each mesh
+	//   (the unpack matrix of the mesh then holds the scale and offset that bring them back)
+	//   pod::e_meshNormalList, e_meshTangentList, e_meshBinormalList: Float32, DEC3N, Int8Norm or Int16Norm
+	//   pod::e_meshUVWList: Float32, or UInt16Norm (the UVs of a mesh that go outside [0, 1] stay Float32, see setRemapUVs)
+	//   pod::e_meshVertexColorList: Float32, UInt8Norm (4 bytes, r g b a) or RGBA
+	//   pod::e_meshBoneIndexList: UInt16 or UInt8 (the indices point into the bones of a batch, at most 8 of them)
+	//   pod::e_meshBoneWeightList: Float32, UInt8Norm or UInt16Norm (rounded so that the weights still add up to 1)
+	void setAttributeFormat(uint32 listIdentifier, DataType::Enum format) { m_attributeFormats[listIdentifier] = format; }
+
+	// Sets the layout of the interleaved vertex data. The attributes a mesh does not have (or that are pruned) are
+	// skipped, and the ones left out of the layout are not written, except for the bone indices and weights which
+	// go at the end when skinning data is exported. The position is required. A compacted tangent frame takes the
+	// place of the normal (QTangent) or of the tangent (TangentWithSign), and is only used if that attribute is
+	// in the layout. Returns false, keeping the current layout, if the layout is not valid.
+	bool setVertexLayout(const VertexLayout& layout);
+
+	// Splits the vertex data in two streams. Each attribute of the position stream is written as a tightly
+	// packed list holding its own data (the e_blockData of e_meshVertexList for the position), placed before
+	// the interleaved data list so that POD loaders read it as vertex data rather than as an offset. The
+	// stride of the interleaved data is padded to the alignment of the layout. A mesh that has nothing left
+	// for the interleaved data list is written in a single stream.
+	void setVertexStreamMode(VertexStreamMode mode) { m_vertexStreamMode = mode; }
+
+	// how the meshes with normals, tangents and bitangents store them. The compacted frames have 4 components,
+	// in the format set for the tangent list (TangentWithSign) or the normal list (QTangent); DEC3N is replaced
+	// by Int8Norm there.
+	void setTangentFrameMode(TangentFrameMode mode) { m_tangentFrameMode = mode; }
+
+	// leave out the vertex streams the material of a mesh cannot use: UVs without any texture, tangents and
+	// bitangents without a normal or height map, and colours that are the same on every vertex (the colour is
+	// multiplied into the diffuse colour and the opacity of the material instead)
+	void setPruneUnusedAttributes(bool prune) { m_pruneUnusedAttributes = prune; }
+
+	// store UVs outside [0, 1] normalized too, remapped per mesh: the offset and scale that bring them back are
+	// written in pod::e_meshUVWUnpack, which is not part of the POD format. Only for loaders that read it,
+	// others would show the remapped UVs.
+	void setRemapUVs(bool remap) { m_remapUVs = remap; }
+
+	// pick for each mesh the smallest position, normal/tangent/bitangent and UV formats that stay within the
+	// quantization limits, instead of the formats given to setAttributeFormat
+	void setAutoQuantize(bool autoQuantize) { m_autoQuantize = autoQuantize; }
+	// largest error allowed by the automatic quantization: a distance in world units for positions (the error on
+	// the mesh is scaled by the largest axis scale of its node's world transformation), an angle
+	// in degrees for directions, and for UVs a number of texels of a textureSize x textureSize texture
+	void setQuantizationLimits(float maxPositionError, float maxDirectionError, float maxUVError, uint textureSize = 2048)
+	{
+		m_maxPositionError = maxPositionError;
+		m_maxDirectionError = maxDirectionError;
+		m_maxUVError = maxUVError;
+		m_uvTextureSize = textureSize;
+	}
+	// write the format, the error and the bytes saved of every attribute of every mesh to a CSV file
+	void setQuantizationReport(const std::string& path) { m_quantizationReportPath = path; }
+
 private:
-	void writeStartTag(uint32 identifier, uint32 dataLength);
-	void writeEndTag(uint32 identifier);
+	// filled by the worker that writes the mesh block, printed once all the meshes are written
+	struct MeshExportStats
+	{
+		struct Attribute
+		{
+			uint32 identifier;
+			DataType::Enum format;
+			uint32 numComponents;
+			float error;	// largest error of the format: a world distance for positions, degrees for directions, UV units for UVs
+		};
+
+		float acmrBefore;
+		float acmrAfter;
+		uint32 numVertices;		// as written
+		uint32 prunedBytesPerVertex;
+		vector<Attribute> attributes;
+	};
+
+	// a mesh as it is written: a whole model, or one part of a model that was split
+	struct ExportMesh
+	{
+		MeshDataPtr meshData;
+		uint modelIndex;	// the model it comes from, which also gives its material and its original node
+		int part;			// -1 if the model was not split
+		// whether the material can use the optional streams (see setPruneUnusedAttributes)
+		bool useTexCoords;
+		bool useTangentFrame;
+		bool useColors;
+	};
+
+	typedef void (PODWriter::*BlockWriterFunc)(uint index, PODBlockBuffer& out);
+
+	void flushBuffer(bool force = false);
+	void emitBuffer(PODBlockBuffer& buffer);
+	void writeBlock(PODBlockBuffer& block);
+	void writeBlocksInParallel(uint numBlocks, BlockWriterFunc blockWriter);
+	void buildExportLists();
+	int32 findExportNodeIndex(const aiNode* node) const;
+	std::string getExportNodeName(uint index) const;
+	DataType::Enum getAttributeFormat(uint32 listIdentifier) const;
+	DataType::Enum selectAttributeFormat(const MeshData& meshData, uint32 listIdentifier, uint32 numComponents, float positionScale, DataType::Enum layoutFormat = DataType::None) const;
+	bool writeQuantizationReport();
+	void resampleNodeAnimations(uint numNodes);
+	void writeStartTag(PODBlockBuffer& out, uint32 identifier, uint32 dataLength);
+	void writeEndTag(PODBlockBuffer& out, uint32 identifier);
+	void optimizeIndexBuffer(uint meshIndex, vector<uint32>& indices, uint numVertices, const int* batchOffsets = NULL, int numBatches = 0);
+	uint optimizeVertexOrder(vector<uint32>& indices, uint numVertices, vector<uint32>& remap);
 
 	void writeSceneBlock();
-	void writeMaterialBlock(uint index);
-	void writeMeshBlock(uint index);
-	void writeNodeBlock(uint index);
-	void writeTextureBlock(uint index);
-	void writeLightBlock(uint index);
-	void writeCameraBlock(uint index);
+	void writeMaterialBlock(uint index, PODBlockBuffer& out);
+	void writeMeshBlock(uint index, PODBlockBuffer& out);
+	void writeNodeBlock(uint index, PODBlockBuffer& out);
+	void writeTextureBlock(uint index, PODBlockBuffer& out);
+	void writeLightBlock(uint index, PODBlockBuffer& out);
+	void writeCameraBlock(uint index, PODBlockBuffer& out);
 
 	ModelLoader m_modelLoader;
 	AnimationHelper m_animationHelper;
@@ -46,6 +201,33 @@ private:
 	bool m_exportAnimations;
 	ExportOptions m_exportOptions;
 	fstream m_fileStream;
+	PODBlockBuffer m_buffer;
+	size_t m_numBytesWritten;
+	uint m_numThreads;
+	unique_ptr<WorkerPool> m_workerPool;
+	OutputMode m_outputMode;
+	unique_ptr<AsyncFileWriter> m_asyncWriter;
+	bool m_optimizeVertexCache;
+	bool m_optimizeVertexFetch;
+	bool m_force32BitIndices;
+	bool m_splitLargeMeshes;
+	map<uint32, DataType::Enum> m_attributeFormats;
+	VertexLayout m_vertexLayout;
+	VertexStreamMode m_vertexStreamMode;
+	TangentFrameMode m_tangentFrameMode;
+	bool m_pruneUnusedAttributes;
+	bool m_autoQuantize;
+	bool m_remapUVs;
+	float m_maxPositionError;
+	float m_maxDirectionError;
+	float m_maxUVError;
+	uint m_uvTextureSize;
+	std::string m_quantizationReportPath;
+	vector<ExportMesh> m_exportMeshes;
+	vector<uint> m_exportNodeSources;	// index in m_Nodes of each written node, the mesh nodes come first
+	vector<int32> m_exportNodeIndices;	// index of the written node, for each node in m_Nodes
+	vector<MeshExportStats> m_meshStats;
+	vector<vector<mat4>> m_nodeAnimations;	// resampled frames of each written node, empty if it is not animated
 };
 
 }
@@ -19,6 +19,7 @@
 ****************************************************************************/
 #include "Common.h"
 #include "PVRTVertex.h"
+#include <math.h>
 
 /****************************************************************************
 ** Defines
@@ -31,6 +32,7 @@
 #define PVRT_MIN(a,b)            (((a) < (b)) ? (a) : (b))
 #define PVRT_MAX(a,b)            (((a) > (b)) ? (a) : (b))
 #define PVRT_CLAMP(x, l, h)      (PVRT_MIN((h), PVRT_MAX((x), (l))))
+#define PVRT_ROUND(x)            (floorf((x) + 0.5f))
 
 /****************************************************************************
 ** Structures
@@ -271,7 +273,7 @@ void PVRTVertexWrite(
 
 		for (i = 0; i < nCnt; ++i)
 		{
-			v[i] = (int)(pData[i] * 511.0f);
+			v[i] = (int)PVRT_ROUND(pData[i] * 511.0f);
 			v[i] = PVRT_CLAMP(v[i], -511, 511);
 			v[i] &= 0x000003ff;
 		}
@@ -291,7 +293,7 @@ void PVRTVertexWrite(
 		unsigned char v[4];
 
 		for (i = 0; i < nCnt; ++i)
-			v[i] = (unsigned char)PVRT_CLAMP(pData[i] * 255.0f, 0.0f, 255.0f);
+			v[i] = (unsigned char)PVRT_CLAMP(PVRT_ROUND(pData[i] * 255.0f), 0.0f, 255.0f);
 
 		for (; i < 4; ++i)
 			v[i] = 0;
@@ -305,7 +307,7 @@ void PVRTVertexWrite(
 		unsigned char v[4];
 
 		for (i = 0; i < nCnt; ++i)
-			v[i] = (unsigned char)PVRT_CLAMP(pData[i] * 255.0f, 0.0f, 255.0f);
+			v[i] = (unsigned char)PVRT_CLAMP(PVRT_ROUND(pData[i] * 255.0f), 0.0f, 255.0f);
 
 		for (; i < 4; ++i)
 			v[i] = 0;
@@ -319,7 +321,7 @@ void PVRTVertexWrite(
 		unsigned char v[4];
 
 		for (i = 0; i < nCnt; ++i)
-			v[i] = (unsigned char)PVRT_CLAMP(pData[i] * 255.0f, 0.0f, 255.0f);
+			v[i] = (unsigned char)PVRT_CLAMP(PVRT_ROUND(pData[i] * 255.0f), 0.0f, 255.0f);
 
 		for (; i < 4; ++i)
 			v[i] = 0;
@@ -369,7 +371,7 @@ void PVRTVertexWrite(
 
 	case EPODDataByteNorm:
 		for (i = 0; i < nCnt; ++i)
-			((char*)pOut)[i] = (char)(pData[i] * (float)((1 << 7) - 1));
+			((char*)pOut)[i] = (char)PVRT_CLAMP(PVRT_ROUND(pData[i] * (float)((1 << 7) - 1)), -127.0f, 127.0f);
 		break;
 
 	case EPODDataUnsignedByte:
@@ -379,7 +381,7 @@ void PVRTVertexWrite(
 
 	case EPODDataUnsignedByteNorm:
 		for (i = 0; i < nCnt; ++i)
-			((char*)pOut)[i] = (unsigned char)(pData[i] * (float)((1 << 8) - 1));
+			((char*)pOut)[i] = (unsigned char)PVRT_CLAMP(PVRT_ROUND(pData[i] * (float)((1 << 8) - 1)), 0.0f, 255.0f);
 		break;
 
 	case EPODDataShort:
@@ -389,7 +391,7 @@ void PVRTVertexWrite(
 
 	case EPODDataShortNorm:
 		for (i = 0; i < nCnt; ++i)
-			((short*)pOut)[i] = (short)(pData[i] * (float)((1 << 15) - 1));
+			((short*)pOut)[i] = (short)PVRT_CLAMP(PVRT_ROUND(pData[i] * (float)((1 << 15) - 1)), -32767.0f, 32767.0f);
 		break;
 
 	case EPODDataUnsignedShort:
@@ -399,7 +401,7 @@ void PVRTVertexWrite(
 
 	case EPODDataUnsignedShortNorm:
 		for (i = 0; i < nCnt; ++i)
-			((unsigned short*)pOut)[i] = (unsigned short)(pData[i] * (float)((1 << 16) - 1));
+			((unsigned short*)pOut)[i] = (unsigned short)PVRT_CLAMP(PVRT_ROUND(pData[i] * (float)((1 << 16) - 1)), 0.0f, 65535.0f);
 		break;
 	}
 }
@@ -0,0 +1,185 @@
+#include "SkeletonEvaluator.h"
+#include "AnimationHelper.h"
+#include <algorithm>
+
+namespace {
+
+void toAffine(const mat4& m, float* out)
+{
+	const float values[12] = {
+		m.a1, m.a2, m.a3, m.a4,
+		m.b1, m.b2, m.b3, m.b4,
+		m.c1, m.c2, m.c3, m.c4 };
+	std::copy(values, values + 12, out);
+}
+
+// out = a * b, with the products summed in the same order as aiMatrix4x4's operator* so that the results are the same
+inline void multiplyAffine(const float* a, const float* b, float* out)
+{
+	for (uint r = 0; r < 3; ++r)
+	{
+		const float* row = a + r * 4;
+		out[r * 4 + 0] = b[0] * row[0] + b[4] * row[1] + b[8] * row[2];
+		out[r * 4 + 1] = b[1] * row[0] + b[5] * row[1] + b[9] * row[2];
+		out[r * 4 + 2] = b[2] * row[0] + b[6] * row[1] + b[10] * row[2];
+		out[r * 4 + 3] = b[3] * row[0] + b[7] * row[1] + b[11] * row[2] + row[3];
+	}
+}
+
+}
+
+SkeletonEvaluator::SkeletonEvaluator(aiNode* pRootNode, aiAnimation* pAnimation, const mat4& globalInverse, const map<string, mat4>& offsetMapping)
+{
+	// depth first, children in order, so that the bones come in the order the recursive walk used to visit them
+	vector<aiNode*> nodes;
+	vector<pair<aiNode*, int>> stack(1, make_pair(pRootNode, -1));
+	while (!stack.empty())
+	{
+		aiNode* pNode = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		int index = (int)nodes.size();
+		nodes.push_back(pNode);
+		m_parents.push_back(parent);
+		for (uint i = pNode->mNumChildren; i > 0; --i)
+		{
+			stack.push_back(make_pair(pNode->mChildren[i - 1], index));
+		}
+	}
+
+	uint numNodes = (uint)nodes.size();
+	AnimationHelper helper;
+	vector<uint> staticNodes;
+	m_localSlots.resize(numNodes);
+	for (uint i = 0; i < numNodes; ++i)
+	{
+		aiNodeAnim* pNodeAnim = helper.findNodeAnim(pAnimation, nodes[i]->mName);
+		if (pNodeAnim)
+		{
+			m_localSlots[i] = (uint)m_channels.size();
+			m_channels.push_back(pNodeAnim);
+		}
+		else
+		{
+			staticNodes.push_back(i);
+		}
+	}
+
+	uint numAnimated = (uint)m_channels.size();
+	for (uint k = 0; k < 12; ++k)
+		m_locals[k].resize(numNodes);
+	for (uint k = 0; k < 3; ++k)
+	{
+		m_positions[k].resize(numAnimated);
+		m_scalings[k].resize(numAnimated);
+	}
+	for (uint k = 0; k < 4; ++k)
+		m_rotations[k].resize(numAnimated);
+
+	for (uint s = 0; s < staticNodes.size(); ++s)
+	{
+		uint slot = numAnimated + s;
+		m_localSlots[staticNodes[s]] = slot;
+
+		float local[12];
+		toAffine(nodes[staticNodes[s]]->mTransformation, local);
+		for (uint k = 0; k < 12; ++k)
+			m_locals[k][slot] = local[k];
+	}
+	m_globals.resize(numNodes * 12);
+
+	for (uint i = 0; i < numNodes; ++i)
+	{
+		auto it = offsetMapping.find(string(nodes[i]->mName.C_Str()));
+		if (it == offsetMapping.end()) continue;
+
+		m_boneNodes.push_back(nodes[i]);
+		m_boneNodeIndices.push_back(i);
+		m_boneOffsets.resize(m_boneOffsets.size() + 12);
+		toAffine(it->second, &m_boneOffsets[m_boneOffsets.size() - 12]);
+	}
+	toAffine(globalInverse, m_globalInverse);
+}
+
+void SkeletonEvaluator::evaluateFrame(uint frameIndex, vector<mat4>& finalTransforms)
+{
+	// gather the keys of the animated nodes
+	uint numAnimated = (uint)m_channels.size();
+	for (uint a = 0; a < numAnimated; ++a)
+	{
+		const aiNodeAnim* pNodeAnim = m_channels[a];
+		const aiVector3D& position = pNodeAnim->mPositionKeys[std::min(frameIndex, pNodeAnim->mNumPositionKeys - 1)].mValue;
+		const aiQuaternion& rotation = pNodeAnim->mRotationKeys[std::min(frameIndex, pNodeAnim->mNumRotationKeys - 1)].mValue;
+		const aiVector3D& scaling = pNodeAnim->mScalingKeys[std::min(frameIndex, pNodeAnim->mNumScalingKeys - 1)].mValue;
+
+		m_positions[0][a] = position.x;
+		m_positions[1][a] = position.y;
+		m_positions[2][a] = position.z;
+		m_rotations[0][a] = rotation.x;
+		m_rotations[1][a] = rotation.y;
+		m_rotations[2][a] = rotation.z;
+		m_rotations[3][a] = rotation.w;
+		m_scalings[0][a] = scaling.x;
+		m_scalings[1][a] = scaling.y;
+		m_scalings[2][a] = scaling.z;
+	}
+
+	// Turn them into local matrices the way aiMatrix4x4(scaling, rotation, position) does it. The loop only reads
+	// and writes arrays at the same index, which lets the compiler do several nodes at once.
+	const float* x = m_rotations[0].data();
+	const float* y = m_rotations[1].data();
+	const float* z = m_rotations[2].data();
+	const float* w = m_rotations[3].data();
+	const float* sx = m_scalings[0].data();
+	const float* sy = m_scalings[1].data();
+	const float* sz = m_scalings[2].data();
+	float* l[12];
+	for (uint k = 0; k < 12; ++k)
+		l[k] = m_locals[k].data();
+	for (uint a = 0; a < numAnimated; ++a)
+	{
+		l[0][a] = (1.0f - 2.0f * (y[a] * y[a] + z[a] * z[a])) * sx[a];
+		l[1][a] = (2.0f * (x[a] * y[a] - z[a] * w[a])) * sx[a];
+		l[2][a] = (2.0f * (x[a] * z[a] + y[a] * w[a])) * sx[a];
+		l[4][a] = (2.0f * (x[a] * y[a] + z[a] * w[a])) * sy[a];
+		l[5][a] = (1.0f - 2.0f * (x[a] * x[a] + z[a] * z[a])) * sy[a];
+		l[6][a] = (2.0f * (y[a] * z[a] - x[a] * w[a])) * sy[a];
+		l[8][a] = (2.0f * (x[a] * z[a] - y[a] * w[a])) * sz[a];
+		l[9][a] = (2.0f * (y[a] * z[a] + x[a] * w[a])) * sz[a];
+		l[10][a] = (1.0f - 2.0f * (x[a] * x[a] + y[a] * y[a])) * sz[a];
+	}
+	std::copy(m_positions[0].begin(), m_positions[0].end(), m_locals[3].begin());
+	std::copy(m_positions[1].begin(), m_positions[1].end(), m_locals[7].begin());
+	std::copy(m_positions[2].begin(), m_positions[2].end(), m_locals[11].begin());
+
+	// the global matrices, the parents being done before their children
+	uint numNodes = (uint)m_parents.size();
+	for (uint i = 0; i < numNodes; ++i)
+	{
+		uint slot = m_localSlots[i];
+		float local[12];
+		for (uint k = 0; k < 12; ++k)
+			local[k] = l[k][slot];
+
+		if (m_parents[i] < 0)
+			std::copy(local, local + 12, &m_globals[i * 12]);
+		else
+			multiplyAffine(&m_globals[m_parents[i] * 12], local, &m_globals[i * 12]);
+	}
+
+	uint numBones = (uint)m_boneNodes.size();
+	finalTransforms.resize(numBones);
+	for (uint b = 0; b < numBones; ++b)
+	{
+		float temp[12], result[12];
+		multiplyAffine(m_globalInverse, &m_globals[m_boneNodeIndices[b] * 12], temp);
+		multiplyAffine(temp, &m_boneOffsets[b * 12], result);
+
+		finalTransforms[b] = mat4(
+			result[0], result[1], result[2], result[3],
+			result[4], result[5], result[6], result[7],
+			result[8], result[9], result[10], result[11],
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
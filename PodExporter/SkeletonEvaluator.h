@@ -0,0 +1,43 @@
+#pragma once
+#include "Common.h"
+#include <assimp/scene.h>
+using namespace std;
+
+// Evaluates the final bone matrices of a node hierarchy at the frames of an animation. The hierarchy is flattened
+// once into arrays, parents before their children, so that evaluating a frame is a few loops over arrays rather
+// than a walk of the nodes: the keys of the animated nodes are gathered into one array per component, turned into
+// local matrices, and every node is then multiplied by its parent. All the matrices are taken to be affine, only
+// their top three rows are computed.
+class SkeletonEvaluator
+{
+public:
+	SkeletonEvaluator(aiNode* pRootNode, aiAnimation* pAnimation, const mat4& globalInverse, const map<string, mat4>& offsetMapping);
+
+	// the nodes that have a bone offset matrix, in the order of the matrices evaluateFrame returns
+	const vector<aiNode*>& getBoneNodes() const { return m_boneNodes; }
+
+	// The final matrix (global inverse * global transform * bone offset) of every bone at the frame. The animated
+	// nodes take their keys at frameIndex, or their last keys if their channel is shorter than that.
+	void evaluateFrame(uint frameIndex, vector<mat4>& finalTransforms);
+
+private:
+	// the nodes, parents first
+	vector<int> m_parents; // -1 for the root
+	vector<uint> m_localSlots; // where the local matrix of the node is in m_locals
+
+	// The local matrices, one array per element (row * 4 + column). The animated nodes come first, in the
+	// order of m_channels, and are rewritten at every frame, the other nodes keep their own transformation.
+	vector<float> m_locals[12];
+	vector<float> m_globals; // 12 floats per node
+
+	// the animated nodes: their channel, and the keys of the frame being evaluated, one array per component
+	vector<const aiNodeAnim*> m_channels;
+	vector<float> m_positions[3];
+	vector<float> m_rotations[4];
+	vector<float> m_scalings[3];
+
+	vector<aiNode*> m_boneNodes;
+	vector<uint> m_boneNodeIndices; // the node of each bone
+	vector<float> m_boneOffsets; // 12 floats per bone
+	float m_globalInverse[12];
+};
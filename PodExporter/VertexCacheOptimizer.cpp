@@ -0,0 +1,224 @@
+#include "VertexCacheOptimizer.h"
+#include <cmath>
+#include <algorithm>
+
+using pvr::uint32;
+
+namespace {
+const int c_cacheSize = 32;
+const float c_cacheDecayPower = 1.5f;
+const float c_lastTriangleScore = 0.75f;
+const float c_valenceBoostScale = 2.0f;
+const float c_valenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, uint numActiveTriangles)
+{
+	// no triangle needs this vertex anymore
+	if (numActiveTriangles == 0) return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// the vertices of the last triangle get a fixed score, so that the next triangle does not
+			// simply pick the same edge again and again
+			score = c_lastTriangleScore;
+		}
+		else
+		{
+			float scaler = 1.0f / (c_cacheSize - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, c_cacheDecayPower);
+		}
+	}
+
+	// boost the vertices with only a few triangles left, so that they get done and leave the cache
+	score += c_valenceBoostScale * powf((float)numActiveTriangles, -c_valenceBoostPower);
+	return score;
+}
+}
+
+namespace VertexCacheOptimizer
+{
+
+void optimize(uint32* indices, uint numIndices, uint numVertices)
+{
+	uint numTriangles = numIndices / 3;
+	if (numTriangles < 2 || numVertices == 0) return;
+
+	// vertex -> triangle adjacency, the active triangles of each vertex are kept at the front of its range
+	vector<uint> numActiveTriangles(numVertices, 0);
+	for (uint i = 0; i < numTriangles * 3; ++i)
+	{
+		++numActiveTriangles[indices[i]];
+	}
+
+	vector<uint> adjacencyOffsets(numVertices + 1, 0);
+	for (uint v = 0; v < numVertices; ++v)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + numActiveTriangles[v];
+	}
+
+	vector<uint> adjacency(numTriangles * 3);
+	vector<uint> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint t = 0; t < numTriangles; ++t)
+	{
+		for (uint k = 0; k < 3; ++k)
+		{
+			adjacency[cursor[indices[t * 3 + k]]++] = t;
+		}
+	}
+
+	vector<int> cachePositions(numVertices, -1);
+	vector<float> vertexScores(numVertices);
+	for (uint v = 0; v < numVertices; ++v)
+	{
+		vertexScores[v] = vertexScore(-1, numActiveTriangles[v]);
+	}
+
+	vector<float> triangleScores(numTriangles);
+	int bestTriangle = -1;
+	float bestScore = -1.0f;
+	for (uint t = 0; t < numTriangles; ++t)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > bestScore)
+		{
+			bestScore = triangleScores[t];
+			bestTriangle = t;
+		}
+	}
+
+	vector<bool> isEmitted(numTriangles, false);
+	vector<uint32> output;
+	output.reserve(numTriangles * 3);
+
+	uint32 cache[c_cacheSize + 3];
+	int cacheCount = 0;
+	uint nextUnemitted = 0;
+
+	for (uint n = 0; n < numTriangles; ++n)
+	{
+		// nothing left around the cache, carry on with the first triangle that has not been emitted
+		if (bestTriangle < 0)
+		{
+			while (isEmitted[nextUnemitted]) ++nextUnemitted;
+			bestTriangle = nextUnemitted;
+		}
+
+		const uint32* triangle = &indices[bestTriangle * 3];
+		isEmitted[bestTriangle] = true;
+		output.push_back(triangle[0]);
+		output.push_back(triangle[1]);
+		output.push_back(triangle[2]);
+
+		// the vertices of the emitted triangle go to the front of the cache
+		uint32 newCache[c_cacheSize + 3];
+		int newCacheCount = 0;
+		for (uint k = 0; k < 3; ++k)
+		{
+			uint32 v = triangle[k];
+
+			// remove the triangle from the active list of the vertex
+			uint first = adjacencyOffsets[v];
+			uint last = first + numActiveTriangles[v] - 1;
+			for (uint i = first; i <= last; ++i)
+			{
+				if (adjacency[i] == (uint)bestTriangle)
+				{
+					std::swap(adjacency[i], adjacency[last]);
+					break;
+				}
+			}
+			--numActiveTriangles[v];
+
+			if (std::find(newCache, newCache + newCacheCount, v) == newCache + newCacheCount)
+			{
+				newCache[newCacheCount++] = v;
+			}
+		}
+
+		for (int i = 0; i < cacheCount; ++i)
+		{
+			if (std::find(newCache, newCache + newCacheCount, cache[i]) == newCache + newCacheCount)
+			{
+				newCache[newCacheCount++] = cache[i];
+			}
+		}
+
+		// update the vertex scores, the ones that dropped out of the cache included
+		for (int i = 0; i < newCacheCount; ++i)
+		{
+			uint32 v = newCache[i];
+			cachePositions[v] = i < c_cacheSize ? i : -1;
+			vertexScores[v] = vertexScore(cachePositions[v], numActiveTriangles[v]);
+		}
+
+		cacheCount = std::min(newCacheCount, c_cacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// the next triangle is picked among the ones touching the vertices whose score changed
+		bestTriangle = -1;
+		bestScore = -1.0f;
+		for (int i = 0; i < newCacheCount; ++i)
+		{
+			uint32 v = newCache[i];
+			for (uint j = 0; j < numActiveTriangles[v]; ++j)
+			{
+				uint t = adjacency[adjacencyOffsets[v] + j];
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+float calcACMR(const uint32* indices, uint numIndices, uint numVertices, uint cacheSize)
+{
+	uint numTriangles = numIndices / 3;
+	if (numTriangles == 0) return 0.0f;
+
+	// FIFO cache: a vertex is in the cache if it was loaded less than cacheSize misses ago
+	vector<uint> loadTimestamps(numVertices, 0);
+	uint numMisses = 0;
+	for (uint i = 0; i < numTriangles * 3; ++i)
+	{
+		uint32 v = indices[i];
+		if (loadTimestamps[v] == 0 || numMisses + 1 - loadTimestamps[v] > cacheSize)
+		{
+			++numMisses;
+			loadTimestamps[v] = numMisses;
+		}
+	}
+
+	return (float)numMisses / numTriangles;
+}
+
+uint optimizeVertexFetch(uint32* indices, uint numIndices, uint numVertices, vector<uint32>& remap)
+{
+	const uint32 unused = 0xffffffff;
+	vector<uint32> newIndices(numVertices, unused);
+
+	remap.clear();
+	remap.reserve(numVertices);
+	for (uint i = 0; i < numIndices; ++i)
+	{
+		uint32& index = newIndices[indices[i]];
+		if (index == unused)
+		{
+			index = (uint32)remap.size();
+			remap.push_back(indices[i]);
+		}
+		indices[i] = index;
+	}
+
+	return (uint)remap.size();
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "Common.h"
+#include "PODDefines.h"
+using std::vector;
+
+// Post-transform vertex cache optimization of triangle lists (Tom Forsyth's "Linear-Speed Vertex
+// Cache Optimisation"): triangles are reordered so that consecutive triangles reuse the vertices
+// that were recently transformed. Only the order of the triangles changes, not the vertices.
+namespace VertexCacheOptimizer
+{
+	// reorder the triangles of a triangle list in place
+	void optimize(pvr::uint32* indices, uint numIndices, uint numVertices);
+
+	// average cache miss ratio: number of transformed vertices per triangle, simulated with a FIFO cache
+	float calcACMR(const pvr::uint32* indices, uint numIndices, uint numVertices, uint cacheSize = 16);
+
+	// renumber the vertices in the order the (already optimized) index list first uses them, so that
+	// the vertex fetch walks through memory linearly. The indices are remapped in place, remap receives
+	// for each new vertex the old vertex it comes from. Vertices that are never used are dropped,
+	// the number of vertices left is returned.
+	uint optimizeVertexFetch(pvr::uint32* indices, uint numIndices, uint numVertices, vector<pvr::uint32>& remap);
+}
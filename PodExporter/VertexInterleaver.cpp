@@ -0,0 +1,120 @@
+#include "VertexInterleaver.h"
+#include "PVRTVertex.h"
+#include <cmath>
+#include <cstring>
+
+using pvr::uint32;
+namespace DataType = pvr::DataType;
+
+namespace {
+
+// N values of type T, copied as they are
+template <typename T, uint N>
+void copyValues(char* dst, uint32 stride, uint numVertices, const char* src, uint32 sourceStride)
+{
+	for (uint i = 0; i < numVertices; ++i)
+	{
+		memcpy(dst + i * stride, src + i * sourceStride, sizeof(T) * N);
+	}
+}
+
+// N floats scaled into a normalized integer format
+template <typename T, uint N>
+void convertNormalized(char* dst, uint32 stride, uint numVertices, const char* src, uint32 sourceStride, float scale, float minValue, float maxValue)
+{
+	for (uint i = 0; i < numVertices; ++i)
+	{
+		float values[N];
+		memcpy(values, src + i * sourceStride, sizeof(values));
+
+		T packed[N];
+		for (uint k = 0; k < N; ++k)
+		{
+			float value = floorf(values[k] * scale + 0.5f);
+			packed[k] = (T)(value < minValue ? minValue : (value > maxValue ? maxValue : value));
+		}
+		memcpy(dst + i * stride, packed, sizeof(packed));
+	}
+}
+
+template <typename T>
+bool copyValues(char* dst, uint32 stride, uint numVertices, uint32 numComponents, const char* src, uint32 sourceStride)
+{
+	switch (numComponents)
+	{
+	case 1: copyValues<T, 1>(dst, stride, numVertices, src, sourceStride); return true;
+	case 2: copyValues<T, 2>(dst, stride, numVertices, src, sourceStride); return true;
+	case 3: copyValues<T, 3>(dst, stride, numVertices, src, sourceStride); return true;
+	case 4: copyValues<T, 4>(dst, stride, numVertices, src, sourceStride); return true;
+	default: return false;
+	}
+}
+
+template <typename T>
+bool convertNormalized(char* dst, uint32 stride, uint numVertices, uint32 numComponents, const char* src, uint32 sourceStride, float scale, float minValue)
+{
+	switch (numComponents)
+	{
+	case 1: convertNormalized<T, 1>(dst, stride, numVertices, src, sourceStride, scale, minValue, scale); return true;
+	case 2: convertNormalized<T, 2>(dst, stride, numVertices, src, sourceStride, scale, minValue, scale); return true;
+	case 3: convertNormalized<T, 3>(dst, stride, numVertices, src, sourceStride, scale, minValue, scale); return true;
+	case 4: convertNormalized<T, 4>(dst, stride, numVertices, src, sourceStride, scale, minValue, scale); return true;
+	default: return false;
+	}
+}
+
+}
+
+namespace VertexInterleaver
+{
+
+void writeAttribute(char* dst, uint32 stride, uint numVertices, DataType::Enum type, uint32 numComponents,
+	const void* source, DataType::Enum sourceType, uint32 sourceStride)
+{
+	const char* src = static_cast<const char*>(source);
+
+	if (type == sourceType)
+	{
+		// the packed formats are a single 32 bit value
+		uint32 numValues = DataType::componentCount(type) > 1 ? 1 : numComponents;
+		bool copied = false;
+		switch (DataType::size(type))
+		{
+		case 4: copied = copyValues<uint32>(dst, stride, numVertices, numValues, src, sourceStride); break;
+		case 2: copied = copyValues<unsigned short>(dst, stride, numVertices, numValues, src, sourceStride); break;
+		case 1: copied = copyValues<unsigned char>(dst, stride, numVertices, numValues, src, sourceStride); break;
+		}
+		if (copied) return;
+	}
+	else if (sourceType == DataType::Float32)
+	{
+		bool converted = false;
+		switch (type)
+		{
+		case DataType::Int8Norm: converted = convertNormalized<signed char>(dst, stride, numVertices, numComponents, src, sourceStride, 127.0f, -127.0f); break;
+		case DataType::UInt8Norm: converted = convertNormalized<unsigned char>(dst, stride, numVertices, numComponents, src, sourceStride, 255.0f, 0.0f); break;
+		case DataType::Int16Norm: converted = convertNormalized<short>(dst, stride, numVertices, numComponents, src, sourceStride, 32767.0f, -32767.0f); break;
+		case DataType::UInt16Norm: converted = convertNormalized<unsigned short>(dst, stride, numVertices, numComponents, src, sourceStride, 65535.0f, 0.0f); break;
+		default: break;
+		}
+		if (converted) return;
+	}
+
+	// the packed formats and everything else go through PVRTVertexWrite, from floats
+	for (uint i = 0; i < numVertices; ++i)
+	{
+		PVRTVECTOR4f value = { 0.0f, 0.0f, 0.0f, 0.0f };
+		memcpy(&value, src + i * sourceStride, numComponents * sizeof(float));
+		PVRTVertexWrite(dst + i * stride, (EPVRTDataType)type, numComponents, &value);
+	}
+}
+
+void gatherVertices(char* dst, const char* src, uint32 stride, const uint32* remap, uint numVertices)
+{
+	for (uint i = 0; i < numVertices; ++i)
+	{
+		memcpy(dst + i * stride, src + remap[i] * stride, stride);
+	}
+}
+
+}
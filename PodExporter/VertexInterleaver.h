@@ -0,0 +1,18 @@
+#pragma once
+#include "Common.h"
+#include "PODDefines.h"
+
+// Writes vertex attributes into interleaved vertex data. The conversion of an attribute is picked once for all
+// its vertices, and the loop over the vertices is instantiated for the value type and the number of components,
+// so that each vertex is written with fixed size loads and stores rather than through PVRTVertexWrite.
+namespace VertexInterleaver
+{
+	// Writes one attribute of numVertices vertices, stride bytes apart from dst. The source values, sourceStride
+	// bytes apart, are copied if they already have the type of the attribute, otherwise they are floats that
+	// get converted (rounded and clamped the way PVRTVertexWrite does it).
+	void writeAttribute(char* dst, pvr::uint32 stride, uint numVertices, pvr::DataType::Enum type, pvr::uint32 numComponents,
+		const void* source, pvr::DataType::Enum sourceType, pvr::uint32 sourceStride);
+
+	// copies whole vertices: vertex i of dst is vertex remap[i] of src
+	void gatherVertices(char* dst, const char* src, pvr::uint32 stride, const pvr::uint32* remap, uint numVertices);
+}
@@ -0,0 +1,102 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(uint numThreads)
+	: m_task(NULL)
+	, m_count(0)
+	, m_nextIndex(0)
+	, m_numBusyWorkers(0)
+	, m_generation(0)
+	, m_quit(false)
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::max(1u, thread::hardware_concurrency());
+	}
+
+	for (uint i = 1; i < numThreads; ++i)
+	{
+		m_workers.push_back(thread(&WorkerPool::workerLoop, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (uint i = 0; i < m_workers.size(); ++i)
+	{
+		m_workers[i].join();
+	}
+}
+
+void WorkerPool::parallelFor(uint count, const function<void(uint)>& task)
+{
+	if (count == 0) return;
+
+	// not worth waking anybody up
+	if (m_workers.empty() || count == 1)
+	{
+		for (uint i = 0; i < count; ++i)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_nextIndex = 0;
+		m_numBusyWorkers = (uint)m_workers.size();
+		++m_generation;
+	}
+	m_wakeUp.notify_all();
+
+	// the calling thread works as well
+	runTasks();
+
+	unique_lock<mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_numBusyWorkers == 0; });
+	m_task = NULL;
+}
+
+void WorkerPool::workerLoop()
+{
+	uint lastGeneration = 0;
+
+	for (;;)
+	{
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [&] { return m_quit || m_generation != lastGeneration; });
+
+			if (m_quit) return;
+			lastGeneration = m_generation;
+		}
+
+		runTasks();
+
+		lock_guard<mutex> lock(m_mutex);
+		if (--m_numBusyWorkers == 0)
+		{
+			m_done.notify_one();
+		}
+	}
+}
+
+void WorkerPool::runTasks()
+{
+	for (;;)
+	{
+		uint index = m_nextIndex++;
+		if (index >= m_count) break;
+
+		(*m_task)(index);
+	}
+}
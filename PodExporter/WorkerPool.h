@@ -0,0 +1,43 @@
+#pragma once
+#include "Common.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+using namespace std;
+
+// A small fixed-size pool of worker threads used to run independent jobs (one per mesh, node, etc.)
+// in parallel. The calling thread takes part in the work, so a pool of N threads spawns N - 1 workers.
+class WorkerPool
+{
+public:
+	// numThreads == 0 means one thread per hardware core
+	explicit WorkerPool(uint numThreads = 0);
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const&) = delete;
+	void operator=(WorkerPool const&) = delete;
+
+	// calls task(i) for every i in [0, count) and returns once all of them are done
+	// the order in which the indices are processed is not defined
+	void parallelFor(uint count, const function<void(uint)>& task);
+
+	uint getNumThreads() const { return (uint)m_workers.size() + 1; }
+
+private:
+	void workerLoop();
+	void runTasks();
+
+	vector<thread> m_workers;
+	mutex m_mutex;
+	condition_variable m_wakeUp;
+	condition_variable m_done;
+
+	const function<void(uint)>* m_task;
+	uint m_count;
+	atomic<uint> m_nextIndex;
+	uint m_numBusyWorkers;
+	uint m_generation;
+	bool m_quit;
+};